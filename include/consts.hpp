@@ -14,12 +14,32 @@ namespace consts {
 constexpr uint16_t READ_REGISTER_COMMAND_LENGTH = 6;
 constexpr uint8_t READ_HOLDING_REGISTER_FUNCTION_CODE = 3;
 constexpr uint8_t READ_INPUT_REGISTER_FUNCTION_CODE = 4;
+constexpr uint8_t READ_COILS_FUNCTION_CODE = 1;
+constexpr uint8_t READ_DISCRETE_INPUTS_FUNCTION_CODE = 2;
+constexpr uint8_t WRITE_SINGLE_COIL_FUNCTION_CODE = 5;
+constexpr uint8_t WRITE_SINGLE_REGISTER_FUNCTION_CODE = 6;
+constexpr uint8_t WRITE_MULTIPLE_COILS_FUNCTION_CODE = 15;
+constexpr uint8_t WRITE_MULTIPLE_REGISTERS_FUNCTION_CODE = 16;
+
+// exception codes sent by servers
+constexpr uint8_t ILLEGAL_FUNCTION = 1;
+constexpr uint8_t ILLEGAL_DATA_ADDRESS = 2;
+constexpr uint8_t ILLEGAL_DATA_VALUE = 3;
+constexpr uint8_t GATEWAY_TARGET_FAILED_TO_RESPOND = 11;
+
+// quantity limits of a single request
+constexpr uint16_t MAX_BITS_PER_READ = 2000;
+constexpr uint16_t MAX_BITS_PER_WRITE = 1968;
+constexpr uint16_t MAX_REGISTERS_PER_READ = 125;
+constexpr uint16_t MAX_REGISTERS_PER_WRITE = 123;
 
 // MODBUS/RTU specific constants
 namespace rtu {
 constexpr uint16_t MAX_ADU = 256;
 constexpr uint16_t MAX_PDU = 253;
 constexpr uint16_t MAX_REGISTER_PER_MESSAGE = 125;
+constexpr uint8_t ADDRESS_LENGTH = 1; // unit id in front of the PDU
+constexpr uint8_t CRC_LENGTH = 2;     // crc16 behind the PDU
 } // namespace rtu
 
 // MODBUS/TCP specific constants
@@ -40,6 +40,22 @@ namespace everest {
                 explicit empty_response( const std::string& what_arg ) : std::runtime_error ( what_arg ) {}
             };
 
+            class transaction_timeout : public std::runtime_error {
+            public:
+                explicit transaction_timeout( const std::string& what_arg ) : std::runtime_error ( what_arg ) {}
+            };
+
+            class unit_suspended : public std::runtime_error {
+            public:
+                explicit unit_suspended( const std::string& what_arg ) : std::runtime_error ( what_arg ) {}
+            };
+
+            // an invalid register map definition or an unknown register name
+            class register_map_error : public std::runtime_error {
+            public:
+                explicit register_map_error( const std::string& what_arg ) : std::runtime_error ( what_arg ) {}
+            };
+
             class should_never_happen : public std::runtime_error {
             public:
                 explicit should_never_happen( const std::string& what_arg ) : std::runtime_error ( what_arg ) {}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+
+#ifndef MODBUS_ASYNC_AWAITABLE_H
+#define MODBUS_ASYNC_AWAITABLE_H
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <modbus/modbus_async_client.hpp>
+
+#define MODBUS_HAVE_COROUTINES 1
+
+namespace everest {
+namespace modbus {
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// C++20 coroutine wrappers over the callback API of ModbusAsyncIPClient. They live outside of the client, so its
+// layout is the same whether or not a translation unit is compiled with coroutine support.
+//
+//     DataVectorUint8 registers = co_await async_read_holding_register(client, 1, 0x0100, 4);
+//
+// The coroutine is resumed from the thread running the loop of the client.
+
+// co_await yields the result or throws the error of the transaction
+class ModbusAwaitable {
+public:
+    using Start = std::function<void(ModbusAsyncIPClient::ResultCallback)>;
+
+    explicit ModbusAwaitable(Start start) : m_start(std::move(start)) {
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle) {
+        m_start([this, handle](std::vector<uint8_t> result, std::exception_ptr error) {
+            m_result = std::move(result);
+            m_error = error;
+            handle.resume();
+        });
+    }
+    std::vector<uint8_t> await_resume() {
+        if (m_error)
+            std::rethrow_exception(m_error);
+        return std::move(m_result);
+    }
+
+private:
+    Start m_start;
+    std::vector<uint8_t> m_result;
+    std::exception_ptr m_error;
+};
+
+inline ModbusAwaitable async_read_holding_register(ModbusAsyncIPClient& client, uint8_t unit_id,
+                                                   uint16_t first_register_address, uint16_t num_registers_to_read) {
+    return ModbusAwaitable([&client, unit_id, first_register_address,
+                            num_registers_to_read](ModbusAsyncIPClient::ResultCallback callback) {
+        client.async_read_holding_register(unit_id, first_register_address, num_registers_to_read,
+                                           std::move(callback));
+    });
+}
+
+inline ModbusAwaitable async_read_input_register(ModbusAsyncIPClient& client, uint8_t unit_id,
+                                                 uint16_t first_register_address, uint16_t num_registers_to_read) {
+    return ModbusAwaitable([&client, unit_id, first_register_address,
+                            num_registers_to_read](ModbusAsyncIPClient::ResultCallback callback) {
+        client.async_read_input_register(unit_id, first_register_address, num_registers_to_read, std::move(callback));
+    });
+}
+
+// the payload is copied, it does not have to outlive the awaitable
+inline ModbusAwaitable async_write_multiple_registers(ModbusAsyncIPClient& client, uint8_t unit_id,
+                                                      uint16_t first_register_address,
+                                                      uint16_t num_registers_to_write,
+                                                      const ModbusDataContainerUint16& payload) {
+    return ModbusAwaitable([&client, unit_id, first_register_address, num_registers_to_write,
+                            payload](ModbusAsyncIPClient::ResultCallback callback) {
+        client.async_write_multiple_registers(unit_id, first_register_address, num_registers_to_write, payload,
+                                              std::move(callback));
+    });
+}
+
+} // namespace modbus
+}; // namespace everest
+
+#endif
+
+#endif
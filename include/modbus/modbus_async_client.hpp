@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+
+#ifndef MODBUS_ASYNC_CLIENT_H
+#define MODBUS_ASYNC_CLIENT_H
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <vector>
+
+#include <connection/event_loop.hpp>
+#include <modbus/modbus_client.hpp>
+
+namespace everest {
+namespace modbus {
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// MODBUS/IP client on an endpoint of a connection::EventLoop, nothing blocks. Results are delivered from the thread
+// running the loop to a callback. C++20 code can co_await them instead, see modbus/modbus_async_awaitable.hpp.
+//
+// Transaction ids are handed out by this client, so there must be only one client per endpoint.
+
+class ModbusAsyncIPClient {
+public:
+    // result holds the register bytes of reads, the complete response of writes. It is empty if error is set.
+    using ResultCallback = std::function<void(std::vector<uint8_t> result, std::exception_ptr error)>;
+
+    ModbusAsyncIPClient(connection::EventLoop& loop, connection::EventLoop::EndpointId endpoint) :
+        m_loop(loop), m_endpoint(endpoint) {
+    }
+
+    // throws derived from std::runtime_error if the request can not be encoded, all other errors are passed to
+    // the callback, see include/modbus/exceptions.hpp and include/connection/exceptions.hpp
+    void async_read_holding_register(uint8_t unit_id, uint16_t first_register_address,
+                                     uint16_t num_registers_to_read, ResultCallback callback);
+    void async_read_input_register(uint8_t unit_id, uint16_t first_register_address, uint16_t num_registers_to_read,
+                                   ResultCallback callback);
+    void async_write_multiple_registers(uint8_t unit_id, uint16_t first_register_address,
+                                        uint16_t num_registers_to_write, const ModbusDataContainerUint16& payload,
+                                        ResultCallback callback);
+
+    // time a transaction may take, measured from submitting its request
+    void set_transaction_timeout(std::chrono::milliseconds timeout) {
+        m_transaction_timeout = timeout;
+    }
+
+private:
+    void async_read(uint8_t function_code, uint8_t unit_id, uint16_t first_register_address,
+                    uint16_t num_registers_to_read, ResultCallback callback);
+    void submit(std::vector<uint8_t> request, bool return_only_registers_bytes, ResultCallback callback);
+
+    connection::EventLoop& m_loop;
+    connection::EventLoop::EndpointId m_endpoint;
+    uint16_t m_next_transaction_id{0};
+    std::chrono::milliseconds m_transaction_timeout{1000};
+};
+
+} // namespace modbus
+}; // namespace everest
+
+#endif
@@ -4,50 +4,115 @@
 #ifndef MODBUS_CLIENT_H
 #define MODBUS_CLIENT_H
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <exception>
 #include <memory>
 #include <vector>
 
 #include <connection/connection.hpp>
 #include <consts.hpp>
+#include <modbus/span.hpp>
 
 namespace everest {
 namespace modbus {
 
+class ModbusDataContainerUint16;
+
 class ModbusClient {
 public:
     ModbusClient(connection::Connection& conn_);
     virtual ~ModbusClient() = default;
-    // read_holding_register needs to be virtual, since the rtu format differs from the ip/udp formats.
+    // read_holding_register needs to be virtual, since the rtu format differs from the ip/udp formats. Ranges of more
+    // than consts::MAX_REGISTERS_PER_READ registers are read in several requests if return_only_registers_bytes is
+    // set, a raw response can only hold one request.
     virtual const std::vector<uint8_t> read_holding_register(uint8_t unit_id, uint16_t first_register_address,
                                                              uint16_t num_registers_to_read,
                                                              bool return_only_registers_bytes = true) const;
+    // Zero copy variant of read_holding_register, returns a view on the register bytes within the receive buffer of
+    // this client. The view is valid until the next transaction of this client.
+    virtual ConstByteSpan read_holding_register_view(uint8_t unit_id, uint16_t first_register_address,
+                                                     uint16_t num_registers_to_read) const;
+    // Reads any number of registers into destination, which has to hold 2 * num_registers_to_read bytes. Ranges of
+    // more than consts::MAX_REGISTERS_PER_READ registers are split into several requests. Returns the number of bytes
+    // written.
+    std::size_t read_holding_register_into(uint8_t unit_id, uint16_t first_register_address,
+                                           uint16_t num_registers_to_read, ByteSpan destination) const;
 
 protected:
     const virtual std::vector<uint8_t> full_message_from_body(const std::vector<uint8_t>& body, uint16_t message_length,
                                                               uint8_t unit_id) const = 0;
 
-    virtual uint16_t validate_response(const std::vector<uint8_t>& response,
-                                       const std::vector<uint8_t>& request) const = 0;
+    virtual uint16_t validate_response(ConstByteSpan response, ConstByteSpan request) const = 0;
 
     // message size including protocol data (addressing, error check, mbap)
     virtual std::size_t max_adu_size() const = 0;
     // message size without protocol data (addressing, error check, mbap), function code and payload data only
     virtual std::size_t max_pdu_size() const = 0;
 
+    // Requests are encoded into a fixed size buffer on the stack, large enough for the ADUs of all protocols.
+    using AduBuffer = std::array<uint8_t, consts::tcp::MAX_ADU>;
+    // position of the PDU within the ADU, the bytes in front of it are protocol data (addressing, mbap)
+    virtual std::size_t pdu_offset() const = 0;
+    // adds the protocol data around the pdu_size bytes of PDU at buffer[pdu_offset()], returns the ADU size
+    virtual std::size_t encode_adu(ByteSpan buffer, std::size_t pdu_size, uint8_t unit_id) const = 0;
+    ConstByteSpan encode_read_request(AduBuffer& buffer, uint8_t function_code, uint8_t unit_id,
+                                      uint16_t first_register_address, uint16_t num_registers_to_read) const;
+    ConstByteSpan encode_write_multiple_registers_request(AduBuffer& buffer, uint8_t unit_id,
+                                                          uint16_t first_register_address,
+                                                          uint16_t num_registers_to_write,
+                                                          const ModbusDataContainerUint16& payload) const;
+
+    // sends the request and receives the response into the receive buffer, returns a view on the validated response
+    virtual ConstByteSpan transceive(ConstByteSpan request) const;
+    // register bytes of a read of any size, see read_holding_register_into
+    std::size_t read_registers_into(uint8_t function_code, uint8_t unit_id, uint16_t first_register_address,
+                                    uint16_t num_registers_to_read, ByteSpan destination) const;
+    // reads chunks of at most consts::MAX_REGISTERS_PER_READ registers one after the other, destination has the size
+    // of all register bytes
+    virtual void read_register_chunks(uint8_t function_code, uint8_t unit_id, uint16_t first_register_address,
+                                      uint16_t num_registers_to_read, ByteSpan destination) const;
+    // view on the register bytes of a validated read response
+    ConstByteSpan register_bytes_of_response(ConstByteSpan response) const;
+
     ModbusClient(const ModbusClient&) = delete;
     ModbusClient& operator=(const ModbusClient&) = delete;
     connection::Connection& conn;
+    mutable AduBuffer m_response_buffer;
 };
 
 class ModbusIPClient : public ModbusClient {
 public:
     ModbusIPClient(connection::Connection& conn_);
     virtual ~ModbusIPClient() = default;
+
+    // a read of the pipelined (TCP) or batched (UDP) transactions
+    struct ReadRequest {
+        uint8_t unit_id;
+        uint16_t first_register_address;
+        uint16_t num_registers_to_read;
+        uint8_t function_code{consts::READ_HOLDING_REGISTER_FUNCTION_CODE};
+    };
+
+    struct TransactionResult {
+        std::vector<uint8_t> response; // empty if the transaction failed
+        std::exception_ptr error;      // set if the transaction failed (timeout, modbus exception, ...)
+    };
+
     const std::vector<uint8_t> full_message_from_body(const std::vector<uint8_t>& body, uint16_t message_length,
                                                       uint8_t unit_id) const override;
-    uint16_t validate_response(const std::vector<uint8_t>& response,
-                               const std::vector<uint8_t>& request) const override;
+    uint16_t validate_response(ConstByteSpan response, ConstByteSpan request) const override;
+
+    // time a single pipelined or batched transaction may take, measured from sending its request
+    void set_transaction_timeout(std::chrono::milliseconds timeout) {
+        m_transaction_timeout = timeout;
+    }
+    std::chrono::milliseconds transaction_timeout() const {
+        return m_transaction_timeout;
+    }
+
     // message size including protocol data (addressing, error check, mbap)
     virtual std::size_t max_adu_size() const override {
         return everest::modbus::consts::tcp::MAX_ADU;
@@ -56,18 +121,67 @@ public:
     virtual std::size_t max_pdu_size() const override {
         return everest::modbus::consts::tcp::MAX_PDU;
     }
+
+protected:
+    std::size_t pdu_offset() const override {
+        return consts::tcp::MBAP_HEADER_LENGTH;
+    }
+    // receives exactly one ADU, its size is taken from the MBAP length field. Throws
+    // connection::exceptions::timeout_error if it does not arrive within the receive timeout of the connection.
+    ConstByteSpan transceive(ConstByteSpan request) const override;
+    std::size_t encode_adu(ByteSpan buffer, std::size_t pdu_size, uint8_t unit_id) const override;
+
+    // transaction ids are handed out per connection, counting up and wrapping around at 0xffff
+    uint16_t next_transaction_id() const {
+        return m_next_transaction_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::chrono::milliseconds m_transaction_timeout{1000};
+
+private:
+    mutable std::atomic<uint16_t> m_next_transaction_id{0};
 };
 
 class ModbusTCPClient : public ModbusIPClient {
 public:
     ModbusTCPClient(connection::TCPConnection& conn_);
     ~ModbusTCPClient() override = default;
+
+    // Sends the requests back-to-back with at most pipeline_window() transactions in flight. Replies are matched to
+    // their requests by MBAP transaction id, so the server may answer in any order. The results are returned in the
+    // order of the requests, a failed transaction does not abort the others.
+    std::vector<TransactionResult> read_registers_pipelined(const std::vector<ReadRequest>& requests,
+                                                            bool return_only_registers_bytes = true) const;
+
+    // number of requests sent without waiting for their replies, at least 1
+    void set_pipeline_window(std::size_t window);
+    std::size_t pipeline_window() const {
+        return m_pipeline_window;
+    }
+
+protected:
+    // the chunks are pipelined
+    void read_register_chunks(uint8_t function_code, uint8_t unit_id, uint16_t first_register_address,
+                              uint16_t num_registers_to_read, ByteSpan destination) const override;
+
+private:
+    connection::TCPConnection& tcp_conn;
+    std::size_t m_pipeline_window{4};
 };
 
 class ModbusUDPClient : public ModbusIPClient {
 public:
     ModbusUDPClient(connection::UDPConnection& conn_);
     ~ModbusUDPClient() override = default;
+
+    // Sends all requests with one sendmmsg and collects the replies with recvmmsg, e.g. to poll many units behind a
+    // gateway. Replies are matched by MBAP transaction id, the results are returned in the order of the requests. A
+    // lost datagram fails its transaction with exceptions::transaction_timeout only.
+    std::vector<TransactionResult> read_registers_batched(const std::vector<ReadRequest>& requests,
+                                                          bool return_only_registers_bytes = true) const;
+
+private:
+    connection::UDPConnection& udp_conn;
 };
 
 using DataVectorUint16 = std::vector<std::uint16_t>;
@@ -87,6 +201,8 @@ public:
     }
 
     DataVectorUint8 get_payload_as_bigendian() const;
+    // writes the payload into buffer, returns the number of bytes written
+    std::size_t copy_payload_as_bigendian(ByteSpan buffer) const;
 
     std::size_t size() const {
         return m_payload.size();
@@ -108,11 +224,18 @@ public:
                                                 uint16_t num_registers_to_read,
                                                 bool return_only_registers_bytes = true) const override;
 
+    ConstByteSpan read_holding_register_view(uint8_t unit_id, uint16_t first_register_address,
+                                             uint16_t num_registers_to_read) const override;
+
     // HACK warning! No virtual method!
     const DataVectorUint8 read_input_register(uint8_t unit_id, uint16_t first_register_address,
                                               uint16_t num_registers_to_read,
                                               bool return_only_registers_bytes = true) const;
-    // throws derived from std::runtime_error, see include/modbus/exceptions.hpp
+    ConstByteSpan read_input_register_view(uint8_t unit_id, uint16_t first_register_address,
+                                           uint16_t num_registers_to_read) const;
+    // throws derived from std::runtime_error, see include/modbus/exceptions.hpp. More than
+    // consts::MAX_REGISTERS_PER_WRITE registers are written in several requests, the response of the last one is
+    // returned.
     DataVectorUint8 write_multiple_registers(
         uint8_t unit_id, uint16_t first_register_address, uint16_t num_registers_to_write,
         const ModbusDataContainerUint16& payload,
@@ -129,11 +252,20 @@ public:
 
     static DataVectorUint8 response_without_protocol_data(const DataVectorUint8& raw_response,
                                                           std::size_t payload_length);
+    // same as response_without_protocol_data, but without copying. The view is clamped to the end of raw_response.
+    static ConstByteSpan view_without_protocol_data(ConstByteSpan raw_response, std::size_t payload_length);
 
 protected:
     const DataVectorUint8 full_message_from_body(const DataVectorUint8& body, uint16_t message_length,
                                                  std::uint8_t unit_id) const override;
-    uint16_t validate_response(const DataVectorUint8& response, const DataVectorUint8& request) const override;
+    uint16_t validate_response(ConstByteSpan response, ConstByteSpan request) const override;
+    ConstByteSpan transceive(ConstByteSpan request) const override;
+    // receives the response to request, skipping the echo of request in front of it if there is one
+    ConstByteSpan receive_response_after_echo(ConstByteSpan request) const;
+    std::size_t pdu_offset() const override {
+        return consts::rtu::ADDRESS_LENGTH;
+    }
+    std::size_t encode_adu(ByteSpan buffer, std::size_t pdu_size, uint8_t unit_id) const override;
     bool ignore_echo;
 };
 
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+
+#ifndef MODBUS_RTU_BUS_SCHEDULER_H
+#define MODBUS_RTU_BUS_SCHEDULER_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include <connection/connection.hpp>
+#include <modbus/modbus_client.hpp>
+
+namespace everest {
+namespace modbus {
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Shares one RS-485 line between many units and many threads. Requests are queued and run one after the other by a
+// worker thread, so there is always exactly one transaction on the bus. SerialDevice::write keeps the silent interval
+// of t3.5 between the frames.
+//
+// Higher priority classes always go first. Within a class the units take turns, so a unit with many queued requests
+// does not delay the others. A unit that did not answer failures_until_suspension() times in a row is suspended:
+// its requests fail with exceptions::unit_suspended without using the bus. After the suspension the next request is
+// sent again, the suspension doubles (up to a maximum) as long as the unit stays silent.
+//
+// The connection must not be used by anything else while the scheduler exists.
+
+class ModbusRTUBusScheduler {
+public:
+    enum struct Priority {
+        High,
+        Normal,
+        Low
+    };
+
+    // runs on the worker thread, the returned bytes are the result of the request
+    using Transaction = std::function<DataVectorUint8(const ModbusRTUClient& client)>;
+
+    // ignore_echo: see ModbusRTUClient
+    explicit ModbusRTUBusScheduler(connection::RTUConnection& connection, bool ignore_echo = false);
+    // requests still queued fail with std::future_error (broken_promise)
+    ~ModbusRTUBusScheduler();
+
+    // thread safe. The future yields the result or throws the error of the transaction, derived from
+    // std::runtime_error, see include/modbus/exceptions.hpp
+    std::future<DataVectorUint8> submit(uint8_t unit_id, Transaction transaction, Priority priority = Priority::Normal);
+
+    std::future<DataVectorUint8> read_holding_register(uint8_t unit_id, uint16_t first_register_address,
+                                                       uint16_t num_registers_to_read,
+                                                       Priority priority = Priority::Normal);
+    std::future<DataVectorUint8> read_input_register(uint8_t unit_id, uint16_t first_register_address,
+                                                     uint16_t num_registers_to_read,
+                                                     Priority priority = Priority::Normal);
+    // the payload is copied
+    std::future<DataVectorUint8> write_multiple_registers(uint8_t unit_id, uint16_t first_register_address,
+                                                          uint16_t num_registers_to_write,
+                                                          const ModbusDataContainerUint16& payload,
+                                                          Priority priority = Priority::Normal);
+
+    // a unit is suspended for initial_suspension after failures transactions without a response in a row
+    void set_suspension(unsigned int failures, std::chrono::milliseconds initial_suspension,
+                        std::chrono::milliseconds max_suspension);
+    unsigned int failures_until_suspension() const;
+    bool is_suspended(uint8_t unit_id) const;
+
+private:
+    static constexpr std::size_t NUM_PRIORITIES = 3;
+
+    struct Job {
+        Transaction transaction;
+        std::promise<DataVectorUint8> result;
+    };
+
+    struct Unit {
+        std::array<std::deque<Job>, NUM_PRIORITIES> queues;
+        unsigned int consecutive_failures{0};
+        std::chrono::milliseconds suspension{0};
+        std::chrono::steady_clock::time_point suspended_until{};
+    };
+
+    ModbusRTUBusScheduler(const ModbusRTUBusScheduler&) = delete;
+    ModbusRTUBusScheduler& operator=(const ModbusRTUBusScheduler&) = delete;
+
+    void run();
+    // called with m_mutex held and at least one job queued
+    Job next_job(uint8_t& unit_id);
+    // called with m_mutex held after each transaction, suspends units that stay silent
+    void update_unit(uint8_t unit_id, bool responded);
+    void fail_queued_jobs(uint8_t unit_id, Unit& unit);
+    bool suspended(const Unit& unit, std::chrono::steady_clock::time_point now) const {
+        return unit.consecutive_failures >= m_failures_until_suspension and now < unit.suspended_until;
+    }
+
+    ModbusRTUClient m_client;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_jobs_queued;
+    std::map<uint8_t, Unit> m_units;                            // by unit id, guarded by m_mutex
+    std::array<int, NUM_PRIORITIES> m_last_unit_id{-1, -1, -1}; // last unit served per priority, guarded by m_mutex
+    std::size_t m_num_queued_jobs{0};                           // guarded by m_mutex
+    bool m_stop_requested{false};                               // guarded by m_mutex
+
+    // guarded by m_mutex
+    unsigned int m_failures_until_suspension{3};
+    std::chrono::milliseconds m_initial_suspension{1000};
+    std::chrono::milliseconds m_max_suspension{60000};
+
+    std::thread m_worker;
+};
+
+} // namespace modbus
+}; // namespace everest
+
+#endif
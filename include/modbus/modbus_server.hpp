@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+
+#ifndef MODBUS_SERVER_H
+#define MODBUS_SERVER_H
+
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <connection/serial_connection_helper.hpp>
+#include <consts.hpp>
+#include <modbus/register_bank.hpp>
+#include <modbus/span.hpp>
+
+namespace everest {
+namespace modbus {
+
+// Answers requests from a RegisterBank. Supported are the function codes to read and write coils and registers
+// (1, 2, 3, 4, 5, 6, 15, 16), all others are answered with the exception ILLEGAL_FUNCTION.
+class ModbusServer {
+public:
+    explicit ModbusServer(RegisterBank& bank) : m_bank(bank) {
+        m_unit_ids.set();
+    }
+    virtual ~ModbusServer() = default;
+
+    // unit ids this server answers for, all by default
+    void set_unit_ids(const std::vector<uint8_t>& unit_ids);
+    bool serves_unit(uint8_t unit_id) const {
+        return m_unit_ids.test(unit_id);
+    }
+
+    // handles the request PDU (function code and data) and writes the response PDU, which is an exception response
+    // for invalid requests. response has to hold consts::tcp::MAX_PDU bytes. Returns the size of the response PDU.
+    std::size_t process_request_pdu(ConstByteSpan request, ByteSpan response);
+
+protected:
+    ModbusServer(const ModbusServer&) = delete;
+    ModbusServer& operator=(const ModbusServer&) = delete;
+
+    RegisterBank& m_bank;
+    std::bitset<256> m_unit_ids;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// MODBUS/TCP server for many concurrent clients, driven by a single epoll loop. All requests that arrived on a
+// connection are answered with one send, responses are encoded directly into the output buffer of the connection.
+// Requests to units this server does not serve are answered with the exception GATEWAY_TARGET_FAILED_TO_RESPOND.
+
+class ModbusTCPServer : public ModbusServer {
+public:
+    // binds and listens, use port 0 to let the system choose one. Throws derived from std::runtime_error
+    ModbusTCPServer(RegisterBank& bank, int port = consts::tcp::DEFAULT_PORT, const std::string& address = "0.0.0.0");
+    ~ModbusTCPServer() override;
+
+    // port the server listens on
+    int port() const {
+        return m_port;
+    }
+    std::size_t num_clients() const {
+        return m_clients.size();
+    }
+
+    // waits at most max_wait for events and handles them, returns the number of requests answered
+    std::size_t run_once(std::chrono::milliseconds max_wait);
+    // runs until stop() is called
+    void run();
+    // thread safe: let run() return
+    void stop();
+
+private:
+    struct Client {
+        int fd;
+        std::vector<uint8_t> input;  // bytes of requests that are not complete yet
+        std::vector<uint8_t> output; // responses not sent yet
+        std::size_t output_offset{0};
+    };
+
+    void accept_clients();
+    std::size_t handle_input(Client& client);
+    bool flush_output(Client& client);
+    void close_client(int fd);
+
+    int m_listen_fd{-1};
+    int m_epoll_fd{-1};
+    int m_wakeup_fd{-1};
+    int m_port;
+    std::map<int, Client> m_clients; // by fd
+
+    std::mutex m_stop_mutex;
+    bool m_stop_requested{false}; // guarded by m_stop_mutex, reset when run() returns
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// MODBUS/RTU server (slave) on a serial line. The end of a request is found by its length, or by silence (the read
+// timeout of the device, at least t3.5) for function codes of unknown length, and checked by its crc. Requests to
+// other units are ignored, broadcasts (unit id 0) are processed without a reply. SerialDevice::write keeps the
+// silent interval of t3.5 in front of the reply.
+
+class ModbusRTUServer : public ModbusServer {
+public:
+    // ignore_echo: the rs485 adapter echoes what is sent, the echo of each reply is read and dropped
+    ModbusRTUServer(RegisterBank& bank, connection::SerialDevice& device, const std::vector<uint8_t>& unit_ids,
+                    bool ignore_echo = false);
+
+    // waits for the next request (at most the initial read timeout of the device) and answers it after the line has
+    // been silent for t3.5. Returns true if a request for this server was processed. Frames that are invalid or
+    // followed by more input before t3.5 are dropped with that input. Throws derived from std::runtime_error on
+    // errors of the device.
+    bool process_next_request();
+    // processes requests until stop() is called
+    void run();
+    // thread safe: let run() return after the current request
+    void stop() {
+        m_stop_requested = true;
+    }
+
+private:
+    connection::SerialDevice& m_device;
+    bool m_ignore_echo;
+    std::atomic<bool> m_stop_requested{false};
+};
+
+} // namespace modbus
+}; // namespace everest
+
+#endif
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#ifndef MODBUS_READ_PLANNER_H
+#define MODBUS_READ_PLANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <vector>
+
+#include <consts.hpp>
+#include <modbus/modbus_client.hpp>
+
+namespace everest {
+namespace modbus {
+
+// Merges many small register reads into few requests. Reads of the same unit and function code are merged if they
+// overlap or if at most gap_tolerance() unrequested registers lie between them, as long as the merged request does
+// not exceed max_registers_per_request() and its gaps do not touch a forbidden range. The register bytes of the
+// merged responses are handed back to each read.
+//
+//     ReadPlanner planner;
+//     planner.add_forbidden_range(1, consts::READ_HOLDING_REGISTER_FUNCTION_CODE, 0x0010, 4);
+//     auto results = planner.read(reads, [&client](const ReadPlanner::Request& request) {
+//         return client.read_holding_register(request.unit_id, request.first_register_address,
+//                                             request.num_registers);
+//     });
+class ReadPlanner {
+public:
+    struct Read {
+        uint8_t unit_id;
+        uint16_t first_register_address;
+        uint16_t num_registers;
+        uint8_t function_code{consts::READ_HOLDING_REGISTER_FUNCTION_CODE}; // or READ_INPUT_REGISTER_FUNCTION_CODE
+    };
+
+    struct Request {
+        uint8_t unit_id;
+        uint16_t first_register_address;
+        uint16_t num_registers;
+        uint8_t function_code;
+        std::vector<std::size_t> reads; // indices of the reads served by this request
+    };
+
+    struct ReadResult {
+        DataVectorUint8 registers; // register bytes of the read, empty if the request failed
+        std::exception_ptr error;  // set if the request serving this read failed
+    };
+
+    // returns the register bytes of the response to request, throws derived from std::runtime_error on errors
+    using Transceive = std::function<DataVectorUint8(const Request& request)>;
+
+    // number of unrequested registers read in between to merge two reads, 0 merges only adjacent reads
+    void set_gap_tolerance(uint16_t registers) {
+        m_gap_tolerance = registers;
+    }
+    uint16_t gap_tolerance() const {
+        return m_gap_tolerance;
+    }
+    void set_max_registers_per_request(uint16_t registers);
+    uint16_t max_registers_per_request() const {
+        return m_max_registers_per_request;
+    }
+
+    // registers a device refuses to read (e.g. answering ILLEGAL_DATA_ADDRESS), they are never read to fill a gap
+    void add_forbidden_range(uint8_t unit_id, uint8_t function_code, uint16_t first_register_address,
+                             uint16_t num_registers);
+
+    // Returns the requests covering all reads. Throws exceptions::message_size_exception if a single read exceeds
+    // max_registers_per_request() and std::invalid_argument if it reads neither holding nor input registers.
+    std::vector<Request> plan(const std::vector<Read>& reads) const;
+
+    // Cuts the register bytes of each read out of the responses, responses[i] belongs to requests[i]. An error of a
+    // request is passed to all of its reads.
+    static std::vector<ReadResult> scatter(const std::vector<Read>& reads, const std::vector<Request>& requests,
+                                           const std::vector<DataVectorUint8>& responses,
+                                           const std::vector<std::exception_ptr>& errors);
+
+    // plans the reads, runs the requests one after the other with transceive and scatters the results
+    std::vector<ReadResult> read(const std::vector<Read>& reads, const Transceive& transceive) const;
+
+private:
+    struct ForbiddenRange {
+        uint8_t unit_id;
+        uint8_t function_code;
+        uint32_t first_register_address;
+        uint32_t end_register_address; // behind the last register
+    };
+
+    // true if a forbidden range of the unit and function code intersects [first, end)
+    bool forbidden(uint8_t unit_id, uint8_t function_code, uint32_t first, uint32_t end) const;
+
+    uint16_t m_gap_tolerance{0};
+    uint16_t m_max_registers_per_request{consts::rtu::MAX_REGISTER_PER_MESSAGE};
+    std::vector<ForbiddenRange> m_forbidden_ranges;
+};
+
+} // namespace modbus
+}; // namespace everest
+
+#endif
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#ifndef MODBUS_REGISTER_BANK_H
+#define MODBUS_REGISTER_BANK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace everest {
+namespace modbus {
+
+// Data served by a MODBUS server: coils, discrete inputs, holding and input registers.
+//
+// Readers (the server threads) never block: the tables are protected by a seqlock, a reader copies the values and
+// retries if a writer was active meanwhile. Writers (the application, or clients writing holding registers and coils)
+// are serialized by a mutex.
+class RegisterBank {
+public:
+    enum struct Table {
+        Coils,
+        DiscreteInputs,
+        HoldingRegisters,
+        InputRegisters
+    };
+
+    RegisterBank(std::size_t num_coils, std::size_t num_discrete_inputs, std::size_t num_holding_registers,
+                 std::size_t num_input_registers);
+
+    std::size_t size(Table table) const;
+    // true if the count entries starting at first exist in table
+    bool contains(Table table, std::size_t first, std::size_t count) const {
+        return count <= size(table) and first <= size(table) - count;
+    }
+
+    // Writer side, throws std::out_of_range if the entries do not exist. Register tables take uint16_t values, bit
+    // tables take 0 / 1.
+    void write(Table table, std::size_t first, const uint16_t* values, std::size_t count);
+    void write(Table table, std::size_t first, uint16_t value) {
+        write(table, first, &value, 1);
+    }
+
+    // Reader side, a consistent snapshot of count entries. Throws std::out_of_range if the entries do not exist.
+    void read(Table table, std::size_t first, uint16_t* values, std::size_t count) const;
+    uint16_t read(Table table, std::size_t first) const {
+        uint16_t value;
+        read(table, first, &value, 1);
+        return value;
+    }
+
+    // Reader side in MODBUS wire format: registers as big endian byte pairs, bits packed lsb first into bytes.
+    // Returns the number of bytes written to destination.
+    std::size_t read_as_bytes(Table table, std::size_t first, std::size_t count, uint8_t* destination) const;
+
+private:
+    struct Storage {
+        std::unique_ptr<std::atomic<uint16_t>[]> values;
+        std::size_t size;
+    };
+
+    const Storage& storage(Table table) const;
+    void check_range(Table table, std::size_t first, std::size_t count) const;
+
+    // copies under the seqlock: reader is called until it saw no concurrent write
+    template <typename Reader> void read_consistent(Reader&& reader) const {
+        while (true) {
+            uint32_t sequence = m_sequence.load(std::memory_order_acquire);
+            if (sequence & 1)
+                continue; // write in progress
+            reader();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_sequence.load(std::memory_order_relaxed) == sequence)
+                return;
+        }
+    }
+
+    Storage m_tables[4];
+    mutable std::atomic<uint32_t> m_sequence{0}; // odd while a write is in progress
+    std::mutex m_write_mutex;
+};
+
+} // namespace modbus
+}; // namespace everest
+
+#endif
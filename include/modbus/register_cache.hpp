@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#ifndef MODBUS_REGISTER_CACHE_H
+#define MODBUS_REGISTER_CACHE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <modbus/modbus_client.hpp>
+
+namespace everest {
+namespace modbus {
+
+// Caches the responses of a ModbusClient shared by several modules, thread safe.
+//
+// A cached read is served until its time to live has passed, without taking a lock: the entries are kept in an
+// immutable snapshot that is replaced as a whole when a response arrives. Each thread keeps its own reference to the
+// current snapshot and compares an atomic version number to see if it is still current, so a hit only loads that
+// number and looks up the entry. The lock is taken to fetch the new snapshot after it was replaced. Concurrent
+// identical reads that miss the cache are collapsed into one transaction, all callers get its result (or its error).
+// Transactions on the client are serialized, errors are not cached.
+class RegisterCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct CachedRegisters {
+        DataVectorUint8 registers;
+        Clock::time_point sampled_at; // when the response was received
+        Clock::time_point expires_at; // served from the cache until then
+
+        Clock::duration age() const {
+            return Clock::now() - sampled_at;
+        }
+    };
+    using CachedRegistersPtr = std::shared_ptr<const CachedRegisters>;
+
+    RegisterCache(const ModbusClient& client, std::chrono::milliseconds default_ttl);
+
+    // reads lying completely within the range are cached for ttl, a ttl of 0 disables caching for them. The range
+    // added last wins if ranges overlap.
+    void set_ttl(uint8_t unit_id, uint16_t first_register_address, uint16_t num_registers,
+                 std::chrono::milliseconds ttl);
+
+    // register bytes, from the cache or from the device. Throws derived from std::runtime_error, see
+    // include/modbus/exceptions.hpp
+    CachedRegistersPtr read_holding_register(uint8_t unit_id, uint16_t first_register_address,
+                                             uint16_t num_registers_to_read);
+
+    // drops all cached reads of the unit, e.g. after writing to it
+    void invalidate(uint8_t unit_id);
+
+private:
+    using Key = uint64_t;
+    using Snapshot = std::unordered_map<Key, CachedRegistersPtr>;
+
+    // the snapshot last seen by a thread, valid as long as m_version did not change
+    struct LocalSnapshot {
+        uint64_t cache_id{0};
+        uint64_t version{0};
+        std::shared_ptr<const Snapshot> snapshot;
+    };
+
+    struct TtlRange {
+        uint8_t unit_id;
+        uint32_t first_register_address;
+        uint32_t end_register_address; // behind the last register
+        std::chrono::milliseconds ttl;
+    };
+
+    static Key make_key(uint8_t unit_id, uint8_t function_code, uint16_t first_register_address,
+                        uint16_t num_registers) {
+        return (Key(unit_id) << 40) | (Key(function_code) << 32) | (Key(first_register_address) << 16) |
+               num_registers;
+    }
+    CachedRegistersPtr lookup(Key key);
+    // called with m_mutex held
+    void replace_snapshot(std::shared_ptr<const Snapshot> snapshot);
+    // called with m_mutex held
+    std::chrono::milliseconds ttl_of(uint8_t unit_id, uint16_t first_register_address, uint16_t num_registers) const;
+
+    const ModbusClient& m_client;
+    std::mutex m_client_mutex; // one transaction at a time
+
+    const uint64_t m_id; // tells the caches apart in the LocalSnapshot of a thread
+    std::atomic<uint64_t> m_version{0}; // incremented whenever m_snapshot is replaced
+
+    std::mutex m_mutex; // guards everything below
+    std::shared_ptr<const Snapshot> m_snapshot;
+    std::unordered_map<Key, std::shared_future<CachedRegistersPtr>> m_in_flight;
+    std::vector<TtlRange> m_ttl_ranges;
+    std::chrono::milliseconds m_default_ttl;
+    // counts the invalidations of each unit, responses of the unit pending meanwhile are not cached
+    std::array<uint64_t, 256> m_generations{};
+};
+
+} // namespace modbus
+}; // namespace everest
+
+#endif
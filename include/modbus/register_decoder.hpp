@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#ifndef MODBUS_REGISTER_DECODER_H
+#define MODBUS_REGISTER_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <modbus/span.hpp>
+
+namespace everest {
+namespace modbus {
+
+// Order of the bytes of a value spanning several registers as they are transferred, A being the most significant
+// byte. A 64 bit value continues the pattern, e.g. CDAB is GH EF CD AB.
+enum struct WordOrder {
+    ABCD, // big endian, high word first (as the MODBUS specification does it for 16 bit values)
+    CDAB, // big endian words, low word first
+    BADC, // little endian words, high word first
+    DCBA, // little endian
+};
+
+// Converts register bytes, as returned by the clients, into typed values in one pass and back. T is one of int16_t,
+// uint16_t, int32_t, uint32_t, float, int64_t, uint64_t and double, each value takes sizeof(T) / 2 registers. 16
+// bytes are converted per step with SSSE3, SSE2 or NEON if the target supports them. Values and register bytes must
+// not overlap.
+
+// fills values from the first values.size() * sizeof(T) register bytes. Throws exceptions::message_size_exception if
+// there are fewer.
+template <typename T>
+void decode_registers(Span<T> values, ConstByteSpan register_bytes, WordOrder word_order = WordOrder::ABCD);
+
+// all values of register_bytes. Throws exceptions::message_size_exception if its size is not a multiple of sizeof(T).
+template <typename T>
+std::vector<T> decode_registers(ConstByteSpan register_bytes, WordOrder word_order = WordOrder::ABCD);
+
+// writes the register bytes of values into register_bytes, e.g. as payload of a write, returns the number of bytes
+// written. Throws exceptions::message_size_exception if register_bytes is too small.
+template <typename T>
+std::size_t encode_registers(ByteSpan register_bytes, Span<const T> values, WordOrder word_order = WordOrder::ABCD);
+
+} // namespace modbus
+}; // namespace everest
+
+#endif
@@ -0,0 +1,293 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#ifndef MODBUS_REGISTER_MAP_H
+#define MODBUS_REGISTER_MAP_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <consts.hpp>
+#include <modbus/exceptions.hpp>
+#include <modbus/register_decoder.hpp>
+#include <modbus/span.hpp>
+#include <modbus/utils.hpp>
+
+namespace everest {
+namespace modbus {
+
+enum struct RegisterType {
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Int64,
+    UInt64,
+    Float64
+};
+
+constexpr uint16_t register_count(RegisterType type) {
+    switch (type) {
+    case RegisterType::Int16:
+    case RegisterType::UInt16:
+        return 1;
+    case RegisterType::Int32:
+    case RegisterType::UInt32:
+    case RegisterType::Float32:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+// a value of a device, multiplied by scale when decoded (e.g. 0.1 for a voltage given in 0.1 V)
+struct RegisterDefinition {
+    const char* name;
+    uint16_t address;
+    RegisterType type;
+    WordOrder word_order{WordOrder::ABCD};
+    double scale{1.0};
+    uint8_t function_code{consts::READ_HOLDING_REGISTER_FUNCTION_CODE};
+};
+
+// registers a device refuses to read, see ReadPlanner::add_forbidden_range
+struct ForbiddenRegisters {
+    uint16_t first_register_address;
+    uint16_t num_registers;
+    uint8_t function_code{consts::READ_HOLDING_REGISTER_FUNCTION_CODE};
+};
+
+struct RegisterMapRequest {
+    uint8_t function_code;
+    uint16_t first_register_address;
+    uint16_t num_registers;
+    std::size_t first_step; // decode steps of the values read by this request
+    std::size_t end_step;
+};
+
+// where a value is found in the register bytes of its request
+struct RegisterDecodeStep {
+    std::size_t value_index; // index of the definition
+    std::size_t byte_offset;
+    RegisterType type;
+    WordOrder word_order;
+    double scale;
+};
+
+namespace register_map {
+
+template <typename T> double decode_value_as(const uint8_t* register_bytes, WordOrder word_order) {
+    T value;
+    decode_registers(Span<T>(&value, 1), ConstByteSpan(register_bytes, sizeof(T)), word_order);
+    return static_cast<double>(value);
+}
+
+// unscaled value of the register bytes of a definition, see decode_registers
+inline double decode_value(const uint8_t* register_bytes, RegisterType type, WordOrder word_order) {
+    switch (type) {
+    case RegisterType::Int16:
+        return decode_value_as<int16_t>(register_bytes, word_order);
+    case RegisterType::UInt16:
+        return decode_value_as<uint16_t>(register_bytes, word_order);
+    case RegisterType::Int32:
+        return decode_value_as<int32_t>(register_bytes, word_order);
+    case RegisterType::UInt32:
+        return decode_value_as<uint32_t>(register_bytes, word_order);
+    case RegisterType::Float32:
+        return decode_value_as<float>(register_bytes, word_order);
+    case RegisterType::Int64:
+        return decode_value_as<int64_t>(register_bytes, word_order);
+    case RegisterType::UInt64:
+        return decode_value_as<uint64_t>(register_bytes, word_order);
+    default:
+        return decode_value_as<double>(register_bytes, word_order);
+    }
+}
+
+} // namespace register_map
+
+// Register map of a device, defined at compile time:
+//
+//     constexpr RegisterDefinition meter_registers[]{
+//         {"voltage_l1", 0x0000, RegisterType::Float32},
+//         {"energy_import", 0x0100, RegisterType::UInt64, WordOrder::CDAB, 0.001},
+//     };
+//     constexpr RegisterMap meter(meter_registers);
+//     static_assert(meter.num_requests() == 2);
+//     constexpr std::size_t voltage_l1 = meter.index_of("voltage_l1");
+//
+//     auto values = meter.read([&client](const RegisterMapRequest& request) {
+//         return client.read_holding_register(1, request.first_register_address, request.num_registers);
+//     });
+//
+// The compiler merges the definitions into read requests, following the rules of ReadPlanner, and works out where
+// each value sits in the response. Forbidden registers are passed after the definitions, they are never read to fill a
+// gap:
+//
+//     constexpr ForbiddenRegisters meter_gaps[]{{0x0002, 1}};
+//     constexpr RegisterMap meter(meter_registers, meter_gaps, 4);
+//
+// Only holding and input registers can be mapped. At runtime, decoding a response just walks its steps. No names are
+// looked up and nothing is allocated. All values are decoded to double, so 64 bit integers above 2^53 lose precision.
+template <std::size_t N> class RegisterMap {
+public:
+    // Definitions of the same function code are merged if at most gap_tolerance unrequested registers lie between
+    // them. Throws exceptions::register_map_error, i.e. does not compile, if a definition exceeds the address range
+    // or has a function code other than READ_HOLDING_REGISTER_FUNCTION_CODE and READ_INPUT_REGISTER_FUNCTION_CODE.
+    constexpr explicit RegisterMap(const RegisterDefinition (&definitions)[N], uint16_t gap_tolerance = 0,
+                                   uint16_t max_registers_per_request = consts::MAX_REGISTERS_PER_READ) {
+        build(definitions, nullptr, 0, gap_tolerance, max_registers_per_request);
+    }
+    // as above, gaps are only read if they do not touch the forbidden registers
+    template <std::size_t M>
+    constexpr RegisterMap(const RegisterDefinition (&definitions)[N], const ForbiddenRegisters (&forbidden)[M],
+                          uint16_t gap_tolerance = 0,
+                          uint16_t max_registers_per_request = consts::MAX_REGISTERS_PER_READ) {
+        build(definitions, forbidden, M, gap_tolerance, max_registers_per_request);
+    }
+
+    static constexpr std::size_t size() {
+        return N;
+    }
+    constexpr const RegisterDefinition& definition(std::size_t index) const {
+        return m_definitions[index];
+    }
+
+    // index of the definition with the given name, throws exceptions::register_map_error if there is none
+    constexpr std::size_t index_of(std::string_view name) const {
+        for (std::size_t index = 0; index < N; ++index)
+            if (name == m_definitions[index].name)
+                return index;
+        throw exceptions::register_map_error("RegisterMap - unknown register name");
+    }
+
+    constexpr std::size_t num_requests() const {
+        return m_num_requests;
+    }
+    constexpr const RegisterMapRequest& request(std::size_t index) const {
+        return m_requests[index];
+    }
+    // PDU of the request, function code and payload
+    std::vector<uint8_t> request_body(std::size_t index) const {
+        return utils::build_read_command_message_body(m_requests[index].function_code,
+                                                      m_requests[index].first_register_address,
+                                                      m_requests[index].num_registers);
+    }
+
+    // Decodes the register bytes of the response to request(request_index) into values, which is indexed like the
+    // definitions. Throws exceptions::message_size_exception if the response is too short.
+    void decode(std::size_t request_index, ConstByteSpan register_bytes, Span<double> values) const {
+
+        const RegisterMapRequest& request = m_requests[request_index];
+        if (register_bytes.size() < 2u * request.num_registers or values.size() < N)
+            throw exceptions::message_size_exception(
+                "RegisterMap - request " + std::to_string(request_index) + " needs " +
+                std::to_string(2 * request.num_registers) + " register bytes, got " +
+                std::to_string(register_bytes.size()));
+
+        for (std::size_t step = request.first_step; step < request.end_step; ++step) {
+            const RegisterDecodeStep& decode_step = m_steps[step];
+            values[decode_step.value_index] = decode_step.scale * register_map::decode_value(
+                                                                      register_bytes.data() + decode_step.byte_offset,
+                                                                      decode_step.type, decode_step.word_order);
+        }
+    }
+
+    // Runs all requests one after the other and decodes their responses. transceive is called with a
+    // RegisterMapRequest and returns the register bytes of the response, its errors are passed on.
+    template <typename Transceive> std::array<double, N> read(Transceive&& transceive) const {
+        std::array<double, N> values{};
+        for (std::size_t index = 0; index < m_num_requests; ++index)
+            decode(index, transceive(m_requests[index]), values);
+        return values;
+    }
+
+private:
+    constexpr void build(const RegisterDefinition (&definitions)[N], const ForbiddenRegisters* forbidden,
+                         std::size_t num_forbidden, uint16_t gap_tolerance, uint16_t max_registers_per_request) {
+
+        // every value has to fit into a request
+        max_registers_per_request = std::min(std::max(max_registers_per_request, register_count(RegisterType::Int64)),
+                                             consts::MAX_REGISTERS_PER_READ);
+
+        std::array<std::size_t, N> order{};
+        for (std::size_t index = 0; index < N; ++index) {
+            m_definitions[index] = definitions[index];
+            order[index] = index;
+            if (uint32_t(definitions[index].address) + register_count(definitions[index].type) > 0x10000)
+                throw exceptions::register_map_error("RegisterMap - definition exceeds the address range");
+            if (definitions[index].function_code != consts::READ_HOLDING_REGISTER_FUNCTION_CODE and
+                definitions[index].function_code != consts::READ_INPUT_REGISTER_FUNCTION_CODE)
+                throw exceptions::register_map_error("RegisterMap - definition does not read registers");
+        }
+
+        // insertion sort by function code and address, std::sort is not constexpr yet
+        for (std::size_t sorted = 1; sorted < N; ++sorted)
+            for (std::size_t index = sorted; index > 0 and before(order[index], order[index - 1]); --index) {
+                const std::size_t swapped = order[index];
+                order[index] = order[index - 1];
+                order[index - 1] = swapped;
+            }
+
+        uint32_t request_end = 0; // behind the last register of the current request
+        for (std::size_t step = 0; step < N; ++step) {
+            const RegisterDefinition& definition = m_definitions[order[step]];
+            const uint32_t end = uint32_t(definition.address) + register_count(definition.type);
+
+            bool merged = false;
+            if (m_num_requests > 0) {
+                RegisterMapRequest& request = m_requests[m_num_requests - 1];
+                const uint32_t merged_end = std::max(request_end, end);
+                if (request.function_code == definition.function_code and
+                    definition.address <= request_end + gap_tolerance and
+                    merged_end - request.first_register_address <= max_registers_per_request and
+                    not touches(forbidden, num_forbidden, definition.function_code, request_end, definition.address)) {
+                    request.num_registers = merged_end - request.first_register_address;
+                    request.end_step = step + 1;
+                    request_end = merged_end;
+                    merged = true;
+                }
+            }
+            if (not merged) {
+                m_requests[m_num_requests++] = {definition.function_code, definition.address,
+                                                register_count(definition.type), step, step + 1};
+                request_end = end;
+            }
+
+            const RegisterMapRequest& request = m_requests[m_num_requests - 1];
+            m_steps[step] = {order[step], 2u * (definition.address - request.first_register_address), definition.type,
+                             definition.word_order, definition.scale};
+        }
+    }
+
+    // true if forbidden registers of the function code intersect [first, end)
+    static constexpr bool touches(const ForbiddenRegisters* forbidden, std::size_t num_forbidden,
+                                  uint8_t function_code, uint32_t first, uint32_t end) {
+        for (std::size_t index = 0; index < num_forbidden; ++index)
+            if (forbidden[index].function_code == function_code and forbidden[index].first_register_address < end and
+                first < uint32_t(forbidden[index].first_register_address) + forbidden[index].num_registers)
+                return true;
+        return false;
+    }
+
+    constexpr bool before(std::size_t lhs, std::size_t rhs) const {
+        return m_definitions[lhs].function_code < m_definitions[rhs].function_code or
+               (m_definitions[lhs].function_code == m_definitions[rhs].function_code and
+                m_definitions[lhs].address < m_definitions[rhs].address);
+    }
+
+    std::array<RegisterDefinition, N> m_definitions{};
+    std::array<RegisterMapRequest, N> m_requests{};
+    std::size_t m_num_requests{0};
+    std::array<RegisterDecodeStep, N> m_steps{}; // grouped by request
+};
+
+} // namespace modbus
+}; // namespace everest
+
+#endif
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#ifndef MODBUS_SPAN_H
+#define MODBUS_SPAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace everest {
+namespace modbus {
+
+// Non owning view on contiguous memory, stands in for std::span as long as C++17 is supported.
+template <typename T> class Span {
+    template <typename Container>
+    using enable_if_container_t =
+        std::enable_if_t<std::is_convertible<decltype(std::declval<Container&>().data()), T*>::value and
+                         not std::is_same<std::remove_cv_t<Container>, Span>::value>;
+
+public:
+    using element_type = T;
+    using value_type = std::remove_cv_t<T>;
+    using size_type = std::size_t;
+    using iterator = T*;
+
+    constexpr Span() noexcept = default;
+    constexpr Span(T* data, size_type size) noexcept : m_data(data), m_size(size) {
+    }
+    template <std::size_t N> constexpr Span(T (&array)[N]) noexcept : m_data(array), m_size(N) {
+    }
+    template <typename Container, typename = enable_if_container_t<Container>>
+    constexpr Span(Container& container) noexcept : m_data(container.data()), m_size(container.size()) {
+    }
+    template <typename Container, typename = enable_if_container_t<const Container>>
+    constexpr Span(const Container& container) noexcept : m_data(container.data()), m_size(container.size()) {
+    }
+
+    constexpr T* data() const noexcept {
+        return m_data;
+    }
+    constexpr size_type size() const noexcept {
+        return m_size;
+    }
+    constexpr bool empty() const noexcept {
+        return m_size == 0;
+    }
+    constexpr iterator begin() const noexcept {
+        return m_data;
+    }
+    constexpr iterator end() const noexcept {
+        return m_data + m_size;
+    }
+    constexpr T& operator[](size_type index) const noexcept {
+        return m_data[index];
+    }
+    T& at(size_type index) const {
+        if (index >= m_size)
+            throw std::out_of_range("Span::at index " + std::to_string(index) + " out of range " +
+                                    std::to_string(m_size));
+        return m_data[index];
+    }
+
+    // views are clamped to the end of this span
+    constexpr Span subspan(size_type offset, size_type count = static_cast<size_type>(-1)) const noexcept {
+        offset = offset < m_size ? offset : m_size;
+        count = count < m_size - offset ? count : m_size - offset;
+        return Span(m_data + offset, count);
+    }
+    constexpr Span first(size_type count) const noexcept {
+        return subspan(0, count);
+    }
+    constexpr Span last(size_type count) const noexcept {
+        return subspan(count < m_size ? m_size - count : 0);
+    }
+
+private:
+    T* m_data{nullptr};
+    size_type m_size{0};
+};
+
+using ByteSpan = Span<std::uint8_t>;
+using ConstByteSpan = Span<const std::uint8_t>;
+
+} // namespace modbus
+}; // namespace everest
+
+#endif
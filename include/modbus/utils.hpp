@@ -3,10 +3,12 @@
 #ifndef MODBUS_UTILS_H
 #define MODBUS_UTILS_H
 
+#include <array>
 #include <cstdint>
 #include <vector>
 
 #include "modbus_client.hpp"
+#include "span.hpp"
 
 namespace everest {
 namespace modbus {
@@ -25,6 +27,30 @@ std::vector<uint8_t> build_write_multiple_register_body(uint16_t first_register_
 std::vector<uint8_t> extract_body_from_response(const std::vector<uint8_t>& response, int num_data_bytes);
 std::vector<uint8_t> extract_registers_bytes_from_response_body(const std::vector<uint8_t>& response_body);
 std::vector<uint8_t> extract_register_bytes_from_response(const std::vector<uint8_t>& response, int num_data_bytes);
+// view on the register bytes of a response body (unit id, function code, byte count, register bytes), nothing is
+// copied. Throws exceptions::unmatched_response if the byte count exceeds the body.
+ConstByteSpan view_registers_bytes_from_response_body(ConstByteSpan response_body);
+
+// Encoding into caller provided buffers, nothing is allocated. The number of bytes written is returned,
+// exceptions::message_size_exception is thrown if the buffer is too small.
+std::size_t encode_read_command_message_body(ByteSpan buffer, std::uint8_t function_code,
+                                             uint16_t first_register_address, uint16_t num_registers_to_read);
+std::size_t encode_write_multiple_register_body(ByteSpan buffer, uint16_t first_register_address,
+                                                uint16_t num_registers_to_write,
+                                                const ::everest::modbus::ModbusDataContainerUint16& payload);
+// same, with the payload given as big endian register bytes
+std::size_t encode_write_multiple_register_body(ByteSpan buffer, uint16_t first_register_address,
+                                                uint16_t num_registers_to_write, ConstByteSpan register_bytes);
+
+// Registers travel big endian. These convert num_registers values in host byte order to register bytes and back,
+// 16 bytes per step with SSSE3 (32 with AVX2), SSE2 or NEON if the target supports them. The buffers must not
+// overlap.
+void registers_to_big_endian(uint8_t* register_bytes, const uint16_t* values, std::size_t num_registers);
+void registers_from_big_endian(uint16_t* values, const uint8_t* register_bytes, std::size_t num_registers);
+// register values of a response, e.g. of read_holding_register(). Throws exceptions::message_size_exception if the
+// number of bytes is odd.
+DataVectorUint16 registers_from_big_endian(ConstByteSpan register_bytes);
+
 void print_message_hex(const std::vector<uint8_t>& message);
 void print_message_first_N_bytes(unsigned char* message, int N);
 
@@ -32,13 +58,67 @@ using PayloadType = unsigned char;
 using CRCResultType = std::uint16_t;
 CRCResultType calcCRC_16_ANSI(const PayloadType* payload, std::size_t payload_length);
 
+// Incremental crc16 for MODBUS/RTU, bytes can be added while they arrive.
+class Crc16Modbus {
+public:
+    Crc16Modbus& update(const PayloadType* payload, std::size_t payload_length);
+    Crc16Modbus& update(PayloadType byte) {
+        return update(&byte, 1);
+    }
+    void reset() {
+        m_crc = 0xffff;
+    }
+
+    // crc of the bytes added so far, same byte order as calcCRC_16_ANSI
+    CRCResultType value() const;
+
+    // true if the bytes added so far end with their own crc, i.e. form a frame with a valid checksum. This holds
+    // because the crc of a frame including its crc (sent low byte first) is always zero.
+    bool frame_valid() const {
+        return m_crc == 0;
+    }
+
+private:
+    std::uint16_t m_crc{0xffff}; // in transmission order, low byte is sent first
+};
+
 // MODBUS/IP specific utils
 namespace ip {
+using AduBuffer = std::array<uint8_t, consts::tcp::MAX_ADU>;
+
 // Utility funcs
-std::vector<uint8_t> make_mbap_header(uint16_t message_length, uint8_t unit_id);
-uint16_t check_mbap_header(const std::vector<uint8_t>& sent_message, const std::vector<uint8_t>& received_message);
+std::vector<uint8_t> make_mbap_header(uint16_t transaction_id, uint16_t message_length, uint8_t unit_id);
+// header with transaction id 0, the clients number their requests themselves
+[[deprecated("pass the transaction id")]] std::vector<uint8_t> make_mbap_header(uint16_t message_length,
+                                                                                uint8_t unit_id);
+uint16_t get_transaction_id(ConstByteSpan message);
+uint16_t check_mbap_header(ConstByteSpan sent_message, ConstByteSpan received_message);
+// writes the MBAP header in front of the pdu_size bytes of PDU at buffer[consts::tcp::MBAP_HEADER_LENGTH]
+std::size_t encode_adu(ByteSpan buffer, uint16_t transaction_id, uint8_t unit_id, std::size_t pdu_size);
+
+// bytes of an ADU needed by frame_length: transaction id, protocol id and length field
+constexpr std::size_t FRAME_HEADER_LENGTH = 6;
+// length of the ADU starting with header, 0 if the length field is invalid
+std::size_t frame_length(const uint8_t* header);
 } // namespace ip
 
+// MODBUS/RTU specific utils
+namespace rtu {
+using AduBuffer = std::array<uint8_t, consts::rtu::MAX_ADU>;
+
+// writes unit id and crc16 around the pdu_size bytes of PDU at buffer[consts::rtu::ADDRESS_LENGTH]
+std::size_t encode_adu(ByteSpan buffer, uint8_t unit_id, std::size_t pdu_size);
+
+// bytes of a response needed by response_frame_length: unit id, function code and byte count / exception code
+constexpr std::size_t RESPONSE_HEADER_LENGTH = 3;
+// length of the response ADU starting with header, 0 for function codes of unknown response size
+std::size_t response_frame_length(const uint8_t* header);
+// bytes of a request needed by request_frame_length: unit id, function code, address, quantity and byte count
+constexpr std::size_t REQUEST_HEADER_LENGTH = 7;
+// length of the request ADU starting with header, 0 for function codes of unknown request size
+std::size_t request_frame_length(const uint8_t* header);
+} // namespace rtu
+
 } // namespace utils
 } // namespace modbus
 }; // namespace everest
@@ -3,7 +3,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <exception>
+#include <memory>
 #include <string>
 #include <termios.h>
 #include <vector>
@@ -13,6 +17,18 @@
 
 namespace everest {
 namespace connection {
+
+// a buffer of a gathered send or of a batch of datagrams, the bytes are not copied
+struct ConstBuffer {
+    const uint8_t* data;
+    std::size_t size;
+};
+
+struct MutableBuffer {
+    uint8_t* data;
+    std::size_t size;
+};
+
 class Connection {
 private:
     Connection(const Connection&) = delete;
@@ -27,39 +43,178 @@ public:
     virtual int make_connection() = 0;
     virtual int close_connection() = 0;
     virtual int send_bytes(const std::vector<uint8_t>& bytes_to_send) = 0;
+    // sends count bytes starting at bytes_to_send, implementations avoid copying them into a vector
+    virtual int send_bytes(const uint8_t* bytes_to_send, std::size_t count) {
+        return send_bytes(std::vector<uint8_t>(bytes_to_send, bytes_to_send + count));
+    }
+    // sends the buffers back to back as if they were one, e.g. a header and a body. Socket connections gather them
+    // in a single syscall, the default concatenates them.
+    virtual int send_buffers(const ConstBuffer* buffers, std::size_t num_buffers) {
+        std::vector<uint8_t> bytes_to_send;
+        for (const ConstBuffer* buffer = buffers; buffer != buffers + num_buffers; ++buffer)
+            bytes_to_send.insert(bytes_to_send.end(), buffer->data, buffer->data + buffer->size);
+        return send_bytes(bytes_to_send.data(), bytes_to_send.size());
+    }
     // result of receive_bytes is a vector that has the size of received bytes
     virtual std::vector<uint8_t> receive_bytes(unsigned int number_of_bytes) = 0;
+    // receives at most count bytes into buffer, returns the number of bytes received
+    virtual std::size_t receive_bytes(uint8_t* buffer, std::size_t count) {
+        std::vector<uint8_t> received_bytes = receive_bytes(count);
+        std::copy(received_bytes.begin(), received_bytes.end(), buffer);
+        return received_bytes.size();
+    }
+    // receives prefix_length bytes followed by a frame of the given format into buffer. Stream oriented connections
+    // use this to stop reading at the end of the frame, the default just receives whatever is available.
+    virtual std::size_t receive_frame(uint8_t* buffer, std::size_t count, const FrameFormat& /* frame_format */,
+                                      std::size_t /* prefix_length */) {
+        return receive_bytes(buffer, count);
+    }
     virtual bool is_valid() const = 0;
 };
 
+// Received bytes are buffered: receive_frame() hands out exactly one frame and keeps the bytes behind it for the
+// next call, so segments holding several frames or only a part of one are handled. Many frames are read per recv.
+// Nagle's algorithm is disabled by default (TCP_NODELAY): requests are sent in one piece and waiting for more data
+// to coalesce with them would only delay the reply.
+// Receives wait at most receive_timeout(), a silent peer makes them throw exceptions::timeout_error.
 class TCPConnection : public Connection {
 private:
     int port;
     std::string address;
     int socket_fd;
+    bool no_delay_enabled{true};
+    std::chrono::milliseconds connect_time_limit;
+    std::chrono::milliseconds receive_time_limit{DEFAULT_RECEIVE_TIMEOUT};
+    std::vector<uint8_t> receive_buffer; // received bytes not handed out yet
+
+    void apply_no_delay();
+    // creates a non-blocking socket and starts connecting, returns true if the connection is established already
+    bool start_connect();
+    // completes a connect that start_connect() left in progress, once the socket is writable
+    void finish_connect();
+    // closes the socket of a failed connect and returns the error to throw
+    std::exception_ptr connect_error(const std::string& reason, bool timed_out);
+
+    struct Deferred {};
+    // does not connect yet
+    TCPConnection(const std::string& address_, int port_, std::chrono::milliseconds connect_timeout_, Deferred);
+
+    // moves a complete frame out of receive_buffer, returns 0 if it is not complete yet
+    std::size_t take_frame(uint8_t* buffer, std::size_t count, const FrameFormat& frame_format,
+                           std::size_t prefix_length);
+    // appends the bytes available on the socket to receive_buffer, blocks if there are none. Returns false and
+    // closes the connection if it was closed by the peer or failed.
+    bool fill_receive_buffer();
+    // waits until the socket itself has data, ignoring receive_buffer
+    bool wait_for_socket(std::chrono::milliseconds timeout);
+    // receive_frame() until deadline, returns 0 on timeout or if the connection was closed
+    std::size_t receive_frame_until(uint8_t* buffer, std::size_t count, const FrameFormat& frame_format,
+                                    std::size_t prefix_length, std::chrono::steady_clock::time_point deadline);
 
 public:
-    TCPConnection(const std::string& address_, const int& port_);
+    static constexpr std::chrono::milliseconds DEFAULT_CONNECT_TIMEOUT{10000};
+    static constexpr std::chrono::milliseconds DEFAULT_RECEIVE_TIMEOUT{5000};
+
+    // Connects right away. Throws exceptions::timeout_error if the connection is not established within
+    // connect_timeout, instead of blocking for the kernel's SYN retries, and tcp_connection_error if it is refused.
+    TCPConnection(const std::string& address_, const int& port_,
+                  std::chrono::milliseconds connect_timeout_ = DEFAULT_CONNECT_TIMEOUT);
     ~TCPConnection();
+    // connects with the connect timeout, also used to reconnect. Throws like the constructor.
     int make_connection();
+
+    struct Endpoint {
+        std::string address;
+        int port;
+    };
+
+    struct ConnectResult {
+        std::unique_ptr<TCPConnection> connection; // always set, not valid if the connect failed
+        std::exception_ptr error;                  // why the connect failed
+    };
+
+    // Connects to all endpoints concurrently, the connects in progress share one deadline timeout from now. Failed
+    // connections are returned as well, make_connection() retries them. Each connection takes a file descriptor.
+    static std::vector<ConnectResult> connect_all(const std::vector<Endpoint>& endpoints,
+                                                  std::chrono::milliseconds timeout);
+
+    void set_connect_timeout(std::chrono::milliseconds timeout) {
+        connect_time_limit = timeout;
+    }
+    std::chrono::milliseconds connect_timeout() const {
+        return connect_time_limit;
+    }
     int send_bytes(const std::vector<uint8_t>& bytes_to_send);
+    int send_bytes(const uint8_t* bytes_to_send, std::size_t count);
+    // one sendmsg for all buffers, continued if the socket accepts only a part of them
+    int send_buffers(const ConstBuffer* buffers, std::size_t num_buffers) override;
     std::vector<uint8_t> receive_bytes(unsigned int number_of_bytes);
+    std::size_t receive_bytes(uint8_t* buffer, std::size_t count);
+    // receives at most count bytes within timeout, throws exceptions::timeout_error if none arrived. The connection
+    // stays open then. Returns 0 if the connection was closed.
+    std::size_t receive_bytes(uint8_t* buffer, std::size_t count, std::chrono::milliseconds timeout);
+    // waits until the frame is complete, returns 0 if the connection was closed meanwhile. Throws
+    // exceptions::timeout_error if the receive timeout expires first, the bytes received so far stay buffered, and
+    // exceptions::communication_error if the length of the frame is invalid, the stream is out of sync then.
+    std::size_t receive_frame(uint8_t* buffer, std::size_t count, const FrameFormat& frame_format,
+                              std::size_t prefix_length) override;
+    // same, but returns 0 if the frame is not complete within timeout. Bytes received so far stay buffered.
+    std::size_t receive_frame(uint8_t* buffer, std::size_t count, const FrameFormat& frame_format,
+                              std::chrono::milliseconds timeout);
+    // waits until receive_bytes() would not block, returns false if the timeout expired first.
+    bool wait_for_data(std::chrono::milliseconds timeout);
+    // applies to receive_bytes() and receive_frame() without a timeout of their own, negative waits forever
+    void set_receive_timeout(std::chrono::milliseconds timeout) {
+        receive_time_limit = timeout;
+    }
+    std::chrono::milliseconds receive_timeout() const {
+        return receive_time_limit;
+    }
+    // false enables Nagle's algorithm again. Applied right away and kept for reconnects.
+    void set_no_delay(bool no_delay);
+    bool no_delay() const {
+        return no_delay_enabled;
+    }
     int close_connection();
     bool is_valid() const;
 };
 
+// Batches of datagrams are sent and received with one sendmmsg / recvmmsg, e.g. requests to many units behind the
+// same gateway. Receives wait at most receive_timeout(), a lost datagram makes them throw exceptions::timeout_error.
 class UDPConnection : public Connection {
 private:
     int port;
     std::string address;
     int socket_fd;
+    std::chrono::milliseconds receive_time_limit{DEFAULT_RECEIVE_TIMEOUT};
 
 public:
+    static constexpr std::chrono::milliseconds DEFAULT_RECEIVE_TIMEOUT{5000};
+
     UDPConnection(const std::string& address_, const int& port_);
     ~UDPConnection();
     int make_connection();
     int send_bytes(const std::vector<uint8_t>& bytes_to_send);
+    int send_bytes(const uint8_t* bytes_to_send, std::size_t count);
+    // the buffers are sent as one datagram
+    int send_buffers(const ConstBuffer* buffers, std::size_t num_buffers) override;
+    // sends every buffer as a datagram of its own, returns the number of datagrams sent
+    int send_datagrams(const ConstBuffer* datagrams, std::size_t num_datagrams);
     std::vector<uint8_t> receive_bytes(unsigned int number_of_bytes);
+    std::size_t receive_bytes(uint8_t* buffer, std::size_t count);
+    // receives a datagram within timeout, throws exceptions::timeout_error if none arrived
+    std::size_t receive_bytes(uint8_t* buffer, std::size_t count, std::chrono::milliseconds timeout);
+    // applies to receive_bytes() without a timeout of its own, negative waits forever
+    void set_receive_timeout(std::chrono::milliseconds timeout) {
+        receive_time_limit = timeout;
+    }
+    std::chrono::milliseconds receive_timeout() const {
+        return receive_time_limit;
+    }
+    // Waits up to timeout for a datagram, then receives it and those already queued behind it, one per buffer. The
+    // sizes of the buffers are set to the sizes of the datagrams. Returns the number of datagrams, 0 on timeout or
+    // when an earlier datagram was refused by the peer.
+    std::size_t receive_datagrams(MutableBuffer* buffers, std::size_t num_buffers, std::chrono::milliseconds timeout);
     int close_connection();
     bool is_valid() const;
 };
@@ -67,7 +222,8 @@ public:
 ////////////////////////////////////////////////////////////////////////////////
 //
 // RTUConnection assumes that there is only *one* device on the serial line, there
-// is no collision handling implemented.
+// is no collision handling implemented. To share the line between several units and
+// threads, use everest::modbus::ModbusRTUBusScheduler.
 
 class RTUConnection : public Connection {
 private:
@@ -82,8 +238,14 @@ public:
     virtual int close_connection() override;
     virtual int
     send_bytes(const std::vector<uint8_t>& bytes_to_send) override; // throws derived from std::runtime_error
+    virtual int send_bytes(const uint8_t* bytes_to_send,
+                           std::size_t count) override; // throws derived from std::runtime_error
     virtual std::vector<uint8_t>
     receive_bytes(unsigned int number_of_bytes) override; // throws derived from std::runtime_error
+    virtual std::size_t receive_bytes(uint8_t* buffer,
+                                      std::size_t count) override; // throws derived from std::runtime_error
+    virtual std::size_t receive_frame(uint8_t* buffer, std::size_t count, const FrameFormat& frame_format,
+                                      std::size_t prefix_length) override; // throws derived from std::runtime_error
     virtual bool is_valid() const override;
 };
 
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace everest {
+namespace connection {
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Single threaded, epoll based reactor for many non blocking MODBUS/IP endpoints.
+//
+// Requests are complete MODBUS/IP ADUs (MBAP header + PDU). Responses are matched to requests by the transaction id
+// of the MBAP header, so several requests can be in flight per endpoint. Completions are always called from
+// run_once(), after the events have been handled, so they may submit new requests or remove endpoints. Except for
+// stop() and post(), all methods have to be called from the thread running the loop (or before it is run).
+
+class EventLoop {
+public:
+    enum class Transport {
+        TCP,
+        UDP
+    };
+
+    using EndpointId = int;
+    // response is the complete ADU, error is set (and response empty) if the request failed
+    using Completion = std::function<void(std::vector<uint8_t> response, std::exception_ptr error)>;
+
+    EventLoop(); // throws derived from std::runtime_error
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // starts a non blocking connect, requests can be submitted right away. Throws derived from std::runtime_error
+    EndpointId add_endpoint(const std::string& address, int port, Transport transport = Transport::TCP);
+    // closes the endpoint, pending requests are completed with an error. Unknown endpoints are ignored.
+    void remove_endpoint(EndpointId endpoint);
+    // true until the endpoint failed, e.g. connection refused or closed by the peer
+    bool is_valid(EndpointId endpoint) const;
+
+    // queues a request, completion is called with the response carrying the same transaction id, or with
+    // exceptions::timeout_error after timeout. Throws exceptions::connection_error for unknown endpoints.
+    void submit(EndpointId endpoint, std::vector<uint8_t> request, Completion completion,
+                std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+
+    // waits at most max_wait for events and handles them, returns the number of completed requests
+    std::size_t run_once(std::chrono::milliseconds max_wait);
+    // runs until stop() is called
+    void run();
+
+    // thread safe: wake up the loop and let run() return
+    void stop();
+    // thread safe: call task from the thread running the loop
+    void post(std::function<void()> task);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Deadline {
+        EndpointId endpoint;
+        uint16_t transaction_id;
+    };
+    // deadlines of all pending requests by time, so timeouts are found without looking at every request
+    using Deadlines = std::multimap<Clock::time_point, Deadline>;
+
+    struct PendingRequest {
+        Completion completion;
+        Deadlines::iterator deadline; // entry in m_deadlines
+    };
+
+    struct Endpoint {
+        EndpointId id;
+        int fd{-1};
+        Transport transport;
+        std::string address;
+        int port;
+        bool connecting{false};
+        std::deque<std::vector<uint8_t>> send_queue;
+        std::size_t send_offset{0}; // bytes of send_queue.front() already sent
+        std::vector<uint8_t> receive_buffer;
+        std::map<uint16_t, PendingRequest> pending; // by transaction id
+    };
+
+    struct ReadyCompletion {
+        Completion completion;
+        std::vector<uint8_t> response;
+        std::exception_ptr error;
+    };
+
+    void handle_events(Endpoint& endpoint, uint32_t events);
+    void flush_send_queue(Endpoint& endpoint);
+    void receive(Endpoint& endpoint);
+    void dispatch_frame(Endpoint& endpoint, const uint8_t* frame, std::size_t size);
+    void fail_endpoint(Endpoint& endpoint, const std::string& reason);
+    void update_interest(Endpoint& endpoint);
+    void expire_requests(Clock::time_point now);
+    void run_posted_tasks();
+    std::size_t run_ready_completions();
+    int next_timeout_ms(std::chrono::milliseconds max_wait) const;
+
+    int m_epoll_fd{-1};
+    int m_wakeup_fd{-1};
+    EndpointId m_next_endpoint_id{0};
+    std::map<EndpointId, std::unique_ptr<Endpoint>> m_endpoints;
+    Deadlines m_deadlines;
+    std::vector<ReadyCompletion> m_ready_completions;
+
+    std::mutex m_posted_mutex;
+    std::vector<std::function<void()>> m_posted_tasks;
+    bool m_stop_requested{false}; // guarded by m_posted_mutex, reset when run() returns
+};
+
+} // namespace connection
+}; // namespace everest
@@ -23,6 +23,13 @@ public:
     }
 };
 
+// a request or a connection attempt did not complete before its deadline
+class timeout_error : public communication_error {
+public:
+    timeout_error(const std::string& what_arg) : communication_error(what_arg) {
+    }
+};
+
 namespace tcp {
 class tcp_connection_error : public connection_error {
 public:
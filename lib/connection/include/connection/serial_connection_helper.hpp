@@ -4,6 +4,7 @@
 #ifndef SERIAL_CONNECTION_HELPER_H_
 #define SERIAL_CONNECTION_HELPER_H_
 
+#include <chrono>
 #include <cstdint>
 #include <string>
 #include <termios.h>
@@ -24,8 +25,17 @@ struct SerialDeviceConfiguration {
         DontInit
     };
 
-    unsigned int initial_read_timeout_deciseconds{50}; // wait for first input
-    unsigned int default_read_timeout_deciseconds{2};  // max wait during reading / wait for end of transmission
+    std::chrono::microseconds initial_read_timeout{std::chrono::seconds(5)}; // wait for first input
+    // max wait during reading / wait for end of transmission, never shorter than t3_5(), or t1_5() between the
+    // characters of a frame whose length is known. USB serial adapters deliver input in chunks with some latency,
+    // with a native uart this can be set to zero to detect the end of frames after the silent interval of 3.5
+    // characters and broken frames after 1.5 characters.
+    std::chrono::microseconds read_timeout{std::chrono::milliseconds(200)};
+
+    // Deprecated decisecond versions of the timeouts above, kept for existing callers. They take precedence if set
+    // to a value other than 0. Not marked [[deprecated]], the implicit copy of the configuration would warn.
+    unsigned int initial_read_timeout_deciseconds{0};
+    unsigned int default_read_timeout_deciseconds{0};
 
     explicit SerialDeviceConfiguration(std::string device); // throws if the device could not be opened.
 
@@ -72,6 +82,7 @@ struct SerialDeviceConfiguration {
      *
      */
     static BaudrateFromIntResult baudrate_from_integer(int);
+    static int baudrate_to_integer(BaudRate);
 
     enum struct DataBits {
         Bit_8 = CS8,
@@ -100,15 +111,33 @@ struct SerialDeviceConfiguration {
 
     // set cread, clocal, disable canonical, disable echo, disable signal chars
     SerialDeviceConfiguration& set_sensible_defaults();
+
+    // time to transmit one character with start, data, parity and stop bits at the configured baud rate
+    std::chrono::microseconds character_time() const;
+    // max silence between the characters of a MODBUS/RTU frame (1.5 character times, fixed above 19200 baud)
+    std::chrono::microseconds t1_5() const;
+    // min silence between two MODBUS/RTU frames (3.5 character times, fixed above 19200 baud)
+    std::chrono::microseconds t3_5() const;
 };
 
 static_assert(std::is_copy_constructible<SerialDeviceConfiguration>::value,
               "SerialDeviceConfiguration needs to be copy constructible!");
 
+// Describes how to find the end of a frame while it is received, so reading can stop without waiting for a timeout.
+struct FrameFormat {
+    ::size_t header_length; // number of bytes needed to know the length of the frame
+    // length of the whole frame given its first header_length bytes, 0 if the length is unknown
+    ::size_t (*frame_length)(const unsigned char* header);
+};
+
 class SerialDevice {
 
     int m_fd = -1;
     SerialDeviceConfiguration m_serial_device_configuration;
+    // end of the last transmission on the line, the next frame must not be sent within t3.5 after it
+    std::chrono::steady_clock::time_point m_line_idle_since{};
+    // read_frame has received the header, reads wait at most the inter character timeout for the next byte
+    bool m_frame_started{false};
 
 protected:
     SerialDevice() {
@@ -125,6 +154,13 @@ public:
 
     virtual ::size_t write(const unsigned char* const buffer, ::size_t count);
     virtual ::size_t read(unsigned char* buffer, ::size_t count);
+    // reads prefix_length bytes (e.g. an echo) followed by a frame of the given format, falls back to read if the
+    // frame length is unknown. Returns the number of bytes read, at most count.
+    virtual ::size_t read_frame(unsigned char* buffer, ::size_t count, const FrameFormat& frame_format,
+                                ::size_t prefix_length = 0);
+    // discards input until the line has been silent for max(read_timeout, t3_5()), which delimits frames. Returns
+    // the number of bytes discarded.
+    virtual ::size_t flush_input_until_silent();
     virtual void drain();
 };
 
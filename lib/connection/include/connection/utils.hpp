@@ -12,6 +12,7 @@ namespace everest {
 namespace connection {
 namespace utils {
 std::string get_bytes_hex_string(const std::vector<uint8_t>& bytes);
-}
+std::string get_bytes_hex_string(const uint8_t* bytes, std::size_t count);
+} // namespace utils
 } // namespace connection
 }; // namespace everest
@@ -0,0 +1,428 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <everest/logging.hpp>
+
+#include <connection/event_loop.hpp>
+#include <connection/exceptions.hpp>
+
+using namespace everest::connection;
+
+// MBAP header: transaction id, protocol id, length (of the bytes following it), unit id
+static constexpr std::size_t MBAP_LENGTH_END = 6;
+static constexpr std::size_t MAX_ADU = 260;
+
+static constexpr uint64_t WAKEUP_EVENT = std::numeric_limits<uint64_t>::max();
+
+static uint16_t transaction_id_of(const uint8_t* frame) {
+    return (frame[0] << 8) | frame[1];
+}
+
+static std::string endpoint_name(const std::string& address, int port) {
+    return address + ":" + std::to_string(port);
+}
+
+EventLoop::EventLoop() {
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd == -1)
+        throw exceptions::connection_error(std::string("EventLoop: epoll_create1 failed: ") + strerror(errno));
+
+    m_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeup_fd == -1) {
+        int error_number = errno;
+        close(m_epoll_fd);
+        throw exceptions::connection_error(std::string("EventLoop: eventfd failed: ") + strerror(error_number));
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKEUP_EVENT;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wakeup_fd, &event);
+}
+
+EventLoop::~EventLoop() {
+
+    for (auto& endpoint : m_endpoints)
+        if (endpoint.second->fd != -1)
+            close(endpoint.second->fd);
+    close(m_wakeup_fd);
+    close(m_epoll_fd);
+}
+
+EventLoop::EndpointId EventLoop::add_endpoint(const std::string& address, int port, Transport transport) {
+
+    auto endpoint = std::make_unique<Endpoint>();
+    endpoint->id = m_next_endpoint_id;
+    endpoint->transport = transport;
+    endpoint->address = address;
+    endpoint->port = port;
+
+    int type = (transport == Transport::TCP ? SOCK_STREAM : SOCK_DGRAM) | SOCK_NONBLOCK | SOCK_CLOEXEC;
+    endpoint->fd = socket(AF_INET, type, 0);
+    if (endpoint->fd == -1)
+        throw exceptions::connection_error("EventLoop: socket creation failed for endpoint " +
+                                           endpoint_name(address, port) + ": " + strerror(errno));
+
+    sockaddr_in server_address{};
+    server_address.sin_family = AF_INET;
+    server_address.sin_port = htons(port);
+    server_address.sin_addr.s_addr = inet_addr(address.c_str());
+
+    if (connect(endpoint->fd, (sockaddr*)&server_address, sizeof(server_address)) == -1) {
+        if (errno != EINPROGRESS) {
+            int error_number = errno;
+            close(endpoint->fd);
+            throw exceptions::connection_error("EventLoop: connect failed for endpoint " +
+                                               endpoint_name(address, port) + ": " + strerror(error_number));
+        }
+        // completion of the connect is signaled by EPOLLOUT
+        endpoint->connecting = true;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN | (endpoint->connecting ? uint32_t(EPOLLOUT) : 0u);
+    event.data.u64 = static_cast<uint64_t>(endpoint->id);
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, endpoint->fd, &event) == -1) {
+        int error_number = errno;
+        close(endpoint->fd);
+        throw exceptions::connection_error("EventLoop: epoll_ctl failed for endpoint " + endpoint_name(address, port) +
+                                           ": " + strerror(error_number));
+    }
+
+    EVLOG_debug << "EventLoop: added endpoint " << endpoint_name(address, port) << ", fd = " << endpoint->fd;
+    EndpointId id = m_next_endpoint_id++;
+    m_endpoints.emplace(id, std::move(endpoint));
+    return id;
+}
+
+void EventLoop::remove_endpoint(EndpointId id) {
+
+    auto endpoint = m_endpoints.find(id);
+    if (endpoint == m_endpoints.end())
+        return;
+
+    fail_endpoint(*endpoint->second, "endpoint removed");
+    m_endpoints.erase(endpoint);
+}
+
+bool EventLoop::is_valid(EndpointId id) const {
+
+    auto endpoint = m_endpoints.find(id);
+    return endpoint != m_endpoints.end() and endpoint->second->fd != -1;
+}
+
+void EventLoop::submit(EndpointId id, std::vector<uint8_t> request, Completion completion,
+                       std::chrono::milliseconds timeout) {
+
+    auto found = m_endpoints.find(id);
+    if (found == m_endpoints.end())
+        throw exceptions::connection_error("EventLoop: submit to unknown endpoint " + std::to_string(id));
+    Endpoint& endpoint = *found->second;
+
+    if (endpoint.fd == -1) {
+        m_ready_completions.push_back({std::move(completion), {},
+                                       std::make_exception_ptr(exceptions::connection_error(
+                                           "EventLoop: endpoint " + endpoint_name(endpoint.address, endpoint.port) +
+                                           " is not connected"))});
+        return;
+    }
+
+    if (request.size() <= MBAP_LENGTH_END) {
+        m_ready_completions.push_back(
+            {std::move(completion), {},
+             std::make_exception_ptr(exceptions::communication_error("EventLoop: request without MBAP header"))});
+        return;
+    }
+
+    uint16_t transaction_id = transaction_id_of(request.data());
+    if (endpoint.pending.count(transaction_id)) {
+        m_ready_completions.push_back(
+            {std::move(completion), {},
+             std::make_exception_ptr(exceptions::communication_error(
+                 "EventLoop: transaction id " + std::to_string(transaction_id) + " is already in flight"))});
+        return;
+    }
+
+    auto deadline = m_deadlines.emplace(Clock::now() + timeout, Deadline{endpoint.id, transaction_id});
+    endpoint.pending.emplace(transaction_id, PendingRequest{std::move(completion), deadline});
+    endpoint.send_queue.push_back(std::move(request));
+    if (not endpoint.connecting)
+        flush_send_queue(endpoint);
+}
+
+std::size_t EventLoop::run_once(std::chrono::milliseconds max_wait) {
+
+    constexpr int max_events = 64;
+    epoll_event events[max_events];
+
+    // completions that are ready already (e.g. submit to a failed endpoint) must not wait for events
+    int timeout_ms = m_ready_completions.empty() ? next_timeout_ms(max_wait) : 0;
+    int num_events = epoll_wait(m_epoll_fd, events, max_events, timeout_ms);
+    if (num_events == -1) {
+        if (errno != EINTR)
+            throw exceptions::communication_error(std::string("EventLoop: epoll_wait failed: ") + strerror(errno));
+        num_events = 0;
+    }
+
+    for (int index = 0; index < num_events; ++index) {
+        if (events[index].data.u64 == WAKEUP_EVENT) {
+            uint64_t counter;
+            while (read(m_wakeup_fd, &counter, sizeof(counter)) > 0) {
+            }
+            continue;
+        }
+        auto endpoint = m_endpoints.find(static_cast<EndpointId>(events[index].data.u64));
+        if (endpoint != m_endpoints.end())
+            handle_events(*endpoint->second, events[index].events);
+    }
+
+    expire_requests(Clock::now());
+    run_posted_tasks();
+    return run_ready_completions();
+}
+
+void EventLoop::run() {
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(m_posted_mutex);
+            if (m_stop_requested) {
+                m_stop_requested = false;
+                return;
+            }
+        }
+        run_once(std::chrono::milliseconds(1000));
+    }
+}
+
+void EventLoop::stop() {
+
+    {
+        std::lock_guard<std::mutex> lock(m_posted_mutex);
+        m_stop_requested = true;
+    }
+    uint64_t one = 1;
+    (void)write(m_wakeup_fd, &one, sizeof(one));
+}
+
+void EventLoop::post(std::function<void()> task) {
+
+    {
+        std::lock_guard<std::mutex> lock(m_posted_mutex);
+        m_posted_tasks.push_back(std::move(task));
+    }
+    uint64_t one = 1;
+    (void)write(m_wakeup_fd, &one, sizeof(one));
+}
+
+void EventLoop::handle_events(Endpoint& endpoint, uint32_t events) {
+
+    if (endpoint.connecting and (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int socket_error = 0;
+        socklen_t length = sizeof(socket_error);
+        getsockopt(endpoint.fd, SOL_SOCKET, SO_ERROR, &socket_error, &length);
+        if (socket_error != 0) {
+            fail_endpoint(endpoint, std::string("connect failed: ") + strerror(socket_error));
+            return;
+        }
+        endpoint.connecting = false;
+        EVLOG_debug << "EventLoop: connected to " << endpoint_name(endpoint.address, endpoint.port);
+    }
+
+    if (events & EPOLLIN)
+        receive(endpoint);
+
+    if (endpoint.fd != -1 and (events & (EPOLLERR | EPOLLHUP)) and not(events & EPOLLIN)) {
+        fail_endpoint(endpoint, "connection closed");
+        return;
+    }
+
+    if (endpoint.fd != -1)
+        flush_send_queue(endpoint);
+}
+
+void EventLoop::flush_send_queue(Endpoint& endpoint) {
+
+    while (not endpoint.send_queue.empty()) {
+        const std::vector<uint8_t>& request = endpoint.send_queue.front();
+        ssize_t bytes_sent = send(endpoint.fd, request.data() + endpoint.send_offset,
+                                  request.size() - endpoint.send_offset, MSG_NOSIGNAL);
+        if (bytes_sent == -1) {
+            if (errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR)
+                break;
+            fail_endpoint(endpoint, std::string("send failed: ") + strerror(errno));
+            return;
+        }
+
+        // datagrams are sent as a whole
+        endpoint.send_offset += bytes_sent;
+        if (endpoint.transport == Transport::UDP or endpoint.send_offset == request.size()) {
+            endpoint.send_queue.pop_front();
+            endpoint.send_offset = 0;
+        }
+    }
+    update_interest(endpoint);
+}
+
+void EventLoop::receive(Endpoint& endpoint) {
+
+    uint8_t buffer[4096];
+
+    while (endpoint.fd != -1) {
+        ssize_t bytes_received = recv(endpoint.fd, buffer, sizeof(buffer), 0);
+        if (bytes_received == -1) {
+            if (errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR)
+                return;
+            fail_endpoint(endpoint, std::string("receive failed: ") + strerror(errno));
+            return;
+        }
+
+        if (endpoint.transport == Transport::UDP) {
+            // one datagram holds one response
+            dispatch_frame(endpoint, buffer, bytes_received);
+            continue;
+        }
+
+        if (bytes_received == 0) {
+            fail_endpoint(endpoint, "connection closed by peer");
+            return;
+        }
+
+        // reassemble the stream into ADUs by the length field of the MBAP header
+        std::vector<uint8_t>& stream = endpoint.receive_buffer;
+        stream.insert(stream.end(), buffer, buffer + bytes_received);
+        std::size_t offset = 0;
+        while (stream.size() - offset >= MBAP_LENGTH_END) {
+            std::size_t length = (stream[offset + 4] << 8) | stream[offset + 5];
+            if (length < 2 or MBAP_LENGTH_END + length > MAX_ADU) {
+                fail_endpoint(endpoint, "invalid MBAP length " + std::to_string(length));
+                return;
+            }
+            if (stream.size() - offset < MBAP_LENGTH_END + length)
+                break;
+            dispatch_frame(endpoint, stream.data() + offset, MBAP_LENGTH_END + length);
+            offset += MBAP_LENGTH_END + length;
+        }
+        stream.erase(stream.begin(), stream.begin() + offset);
+    }
+}
+
+void EventLoop::dispatch_frame(Endpoint& endpoint, const uint8_t* frame, std::size_t size) {
+
+    if (size <= MBAP_LENGTH_END)
+        return;
+
+    auto pending = endpoint.pending.find(transaction_id_of(frame));
+    if (pending == endpoint.pending.end()) {
+        // late reply to a request that timed out already
+        EVLOG_debug << "EventLoop: discarding response with unknown transaction id " << transaction_id_of(frame)
+                    << " from " << endpoint_name(endpoint.address, endpoint.port);
+        return;
+    }
+
+    m_ready_completions.push_back({std::move(pending->second.completion), std::vector<uint8_t>(frame, frame + size),
+                                   nullptr});
+    m_deadlines.erase(pending->second.deadline);
+    endpoint.pending.erase(pending);
+}
+
+void EventLoop::fail_endpoint(Endpoint& endpoint, const std::string& reason) {
+
+    std::string message = "EventLoop: endpoint " + endpoint_name(endpoint.address, endpoint.port) + ": " + reason;
+    if (endpoint.fd != -1) {
+        EVLOG_error << message;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, endpoint.fd, nullptr);
+        close(endpoint.fd);
+        endpoint.fd = -1;
+    }
+
+    std::exception_ptr error = std::make_exception_ptr(exceptions::communication_error(message));
+    for (auto& pending : endpoint.pending) {
+        m_ready_completions.push_back({std::move(pending.second.completion), {}, error});
+        m_deadlines.erase(pending.second.deadline);
+    }
+    endpoint.pending.clear();
+    endpoint.send_queue.clear();
+    endpoint.send_offset = 0;
+    endpoint.receive_buffer.clear();
+}
+
+void EventLoop::update_interest(Endpoint& endpoint) {
+
+    epoll_event event{};
+    event.events = EPOLLIN | ((endpoint.connecting or not endpoint.send_queue.empty()) ? uint32_t(EPOLLOUT) : 0u);
+    event.data.u64 = static_cast<uint64_t>(endpoint.id);
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, endpoint.fd, &event);
+}
+
+void EventLoop::expire_requests(Clock::time_point now) {
+
+    while (not m_deadlines.empty() and m_deadlines.begin()->first <= now) {
+        const Deadline expired = m_deadlines.begin()->second;
+        m_deadlines.erase(m_deadlines.begin());
+
+        Endpoint& endpoint = *m_endpoints.at(expired.endpoint);
+        auto request = endpoint.pending.find(expired.transaction_id);
+        m_ready_completions.push_back(
+            {std::move(request->second.completion), {},
+             std::make_exception_ptr(exceptions::timeout_error(
+                 "EventLoop: no response for transaction id " + std::to_string(expired.transaction_id) + " from " +
+                 endpoint_name(endpoint.address, endpoint.port)))});
+        endpoint.pending.erase(request);
+
+        // a request that was not sent yet is dropped, its transaction id may be reused by the next submit. A partially
+        // sent front has to be completed to keep the stream in sync.
+        auto unsent = std::find_if(endpoint.send_queue.begin() + (endpoint.send_offset > 0 ? 1 : 0),
+                                   endpoint.send_queue.end(), [&](const std::vector<uint8_t>& queued) {
+                                       return transaction_id_of(queued.data()) == expired.transaction_id;
+                                   });
+        if (unsent != endpoint.send_queue.end()) {
+            endpoint.send_queue.erase(unsent);
+            update_interest(endpoint);
+        }
+    }
+}
+
+void EventLoop::run_posted_tasks() {
+
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(m_posted_mutex);
+        tasks.swap(m_posted_tasks);
+    }
+    for (auto& task : tasks)
+        task();
+}
+
+std::size_t EventLoop::run_ready_completions() {
+
+    // completions may submit requests, which can complete right away: those are run by the next run_once
+    std::vector<ReadyCompletion> ready;
+    ready.swap(m_ready_completions);
+    for (auto& entry : ready)
+        entry.completion(std::move(entry.response), entry.error);
+    return ready.size();
+}
+
+int EventLoop::next_timeout_ms(std::chrono::milliseconds max_wait) const {
+
+    Clock::time_point wake_up = Clock::now() + max_wait;
+    if (not m_deadlines.empty())
+        wake_up = std::min(wake_up, m_deadlines.begin()->first);
+
+    // round up, waking up before the deadline would just cause another iteration
+    auto timeout = std::chrono::ceil<std::chrono::milliseconds>(wake_up - Clock::now());
+    return timeout.count() < 0 ? 0 : static_cast<int>(timeout.count());
+}
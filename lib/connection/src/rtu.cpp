@@ -37,9 +37,13 @@ int RTUConnection::close_connection() {
 }
 
 int RTUConnection::send_bytes(const std::vector<uint8_t>& bytes_to_send) {
+    return send_bytes(bytes_to_send.data(), bytes_to_send.size());
+}
+
+int RTUConnection::send_bytes(const uint8_t* bytes_to_send, std::size_t count) {
 
     try {
-        auto bytes_written = m_serial_device.write(bytes_to_send.data(), bytes_to_send.size());
+        auto bytes_written = m_serial_device.write(bytes_to_send, count);
         return bytes_written;
     } catch (const std::runtime_error& e) {
         close_connection();
@@ -51,21 +55,40 @@ int RTUConnection::send_bytes(const std::vector<uint8_t>& bytes_to_send) {
 
 std::vector<uint8_t> RTUConnection::receive_bytes(unsigned int number_of_bytes) {
 
+    std::vector<uint8_t> result(number_of_bytes);
+    result.resize(receive_bytes(result.data(), result.size()));
+    return result;
+}
+
+std::size_t RTUConnection::receive_bytes(uint8_t* buffer, std::size_t count) {
+
     if (not is_valid()) {
         throw std::runtime_error("attempt to read on invalid rtu connection.");
     }
 
-    std::vector<uint8_t> result(number_of_bytes);
+    try {
+        return m_serial_device.read(buffer, count);
+    } catch (const std::runtime_error& e) {
+        close_connection();
+        EVLOG_error << "Error reading on RTU connection: " << e.what() << std::endl;
+        throw;
+    }
+}
+
+std::size_t RTUConnection::receive_frame(uint8_t* buffer, std::size_t count, const FrameFormat& frame_format,
+                                         std::size_t prefix_length) {
+
+    if (not is_valid()) {
+        throw std::runtime_error("attempt to read on invalid rtu connection.");
+    }
 
     try {
-        auto bytes_read = m_serial_device.read(result.data(), number_of_bytes);
-        result.resize(bytes_read);
+        return m_serial_device.read_frame(buffer, count, frame_format, prefix_length);
     } catch (const std::runtime_error& e) {
         close_connection();
         EVLOG_error << "Error reading on RTU connection: " << e.what() << std::endl;
         throw;
     }
-    return result;
 }
 
 bool RTUConnection::is_valid() const {
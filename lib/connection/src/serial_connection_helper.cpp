@@ -4,8 +4,13 @@
 #include <connection/exceptions.hpp>
 #include <connection/serial_connection_helper.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 #include <errno.h>   // Error integer and strerror() function
 #include <fcntl.h>   // Contains file controls like O_RDWR
+#include <poll.h>    // ppoll() to wait for input with a timeout
 #include <string.h>
 #include <termios.h> // Contains POSIX terminal control definitions
 #include <unistd.h>  // write(), read(), close()
@@ -23,8 +28,8 @@ void update_timeout_configuration(termios* tty, unsigned int timeout_deciseconds
 void set_baudrate(termios* tty, everest::connection::SerialDeviceConfiguration::BaudRate);
 void configure_device(int serial_port_fd, termios* tty);
 ::size_t write_to_device(int serial_port_fd, const unsigned char* const buffer, ::size_t count);
-::size_t read_from_device(int serial_port_fd, unsigned char* buffer, ::size_t count, termios* tty_config,
-                          unsigned int initial_timeout_deciseconds, unsigned int timeout_deciseconds);
+::size_t read_from_device(int serial_port_fd, unsigned char* buffer, ::size_t count,
+                          std::chrono::microseconds initial_timeout, std::chrono::microseconds timeout);
 } // namespace serial_connection_helper
 } // namespace connection
 } // namespace everest
@@ -67,6 +72,66 @@ everest::connection::SerialDeviceConfiguration::baudrate_from_integer(int baudra
     }
 }
 
+int everest::connection::SerialDeviceConfiguration::baudrate_to_integer(BaudRate baudrate) {
+    switch (baudrate) {
+    case BaudRate::Baud_0:
+        return 0;
+    case BaudRate::Baud_50:
+        return 50;
+    case BaudRate::Baud_75:
+        return 75;
+    case BaudRate::Baud_110:
+        return 110;
+    case BaudRate::Baud_134:
+        return 134;
+    case BaudRate::Baud_150:
+        return 150;
+    case BaudRate::Baud_200:
+        return 200;
+    case BaudRate::Baud_300:
+        return 300;
+    case BaudRate::Baud_600:
+        return 600;
+    case BaudRate::Baud_1200:
+        return 1200;
+    case BaudRate::Baud_1800:
+        return 1800;
+    case BaudRate::Baud_2400:
+        return 2400;
+    case BaudRate::Baud_4800:
+        return 4800;
+    case BaudRate::Baud_9600:
+        return 9600;
+    case BaudRate::Baud_19200:
+        return 19200;
+    case BaudRate::Baud_38400:
+        return 38400;
+    case BaudRate::Baud_57600:
+        return 57600;
+    case BaudRate::Baud_115200:
+        return 115200;
+    case BaudRate::Baud_230400:
+        return 230400;
+    case BaudRate::Baud_460800:
+        return 460800;
+    case BaudRate::Baud_500000:
+        return 500000;
+    case BaudRate::Baud_576000:
+        return 576000;
+    case BaudRate::Baud_921600:
+        return 921600;
+    case BaudRate::Baud_1000000:
+        return 1000000;
+    case BaudRate::Baud_1152000:
+        return 1152000;
+    case BaudRate::Baud_1500000:
+        return 1500000;
+    case BaudRate::Baud_2000000:
+        return 2000000;
+    }
+    return 0;
+}
+
 namespace ecs = everest::connection::serial_connection_helper;
 
 everest::connection::SerialDeviceConfiguration::SerialDeviceConfiguration(std::string device) : m_device(device) {
@@ -80,7 +145,11 @@ void everest::connection::SerialDevice::open() {
 
     close();
     m_fd = ::ecs::open_serial_device(get_serial_device_config().m_device);
-    ::ecs::configure_device(m_fd, &get_serial_device_config().m_tty_config);
+
+    // configure the tty once, reads dont block in the driver, timeouts are handled by read_from_device
+    termios tty_config = get_serial_device_config().m_tty_config;
+    ::ecs::update_timeout_configuration(&tty_config, 0);
+    ::ecs::configure_device(m_fd, &tty_config);
 }
 
 void everest::connection::SerialDevice::close() {
@@ -96,18 +165,88 @@ everest::connection::SerialDeviceConfiguration& everest::connection::SerialDevic
 
 ::size_t everest::connection::SerialDevice::write(const unsigned char* const buffer, ::size_t count) {
 
-    return ::ecs::write_to_device(m_fd, buffer, count);
+    // keep the silent interval between frames, the previous frame could have been answered very fast
+    std::this_thread::sleep_until(m_line_idle_since + get_serial_device_config().t3_5());
+    ::size_t bytes_written = ::ecs::write_to_device(m_fd, buffer, count);
+    m_line_idle_since = std::chrono::steady_clock::now();
+    return bytes_written;
 }
 
 void everest::connection::SerialDevice::drain() {
     tcdrain(m_fd);
 }
 
+// the timeouts of config, replaced by the deprecated decisecond ones if a caller still sets them
+static std::chrono::microseconds initial_read_timeout(const everest::connection::SerialDeviceConfiguration& config) {
+    if (config.initial_read_timeout_deciseconds != 0)
+        return std::chrono::milliseconds(100) * config.initial_read_timeout_deciseconds;
+    return config.initial_read_timeout;
+}
+
+static std::chrono::microseconds read_timeout(const everest::connection::SerialDeviceConfiguration& config) {
+    if (config.default_read_timeout_deciseconds != 0)
+        return std::chrono::milliseconds(100) * config.default_read_timeout_deciseconds;
+    return config.read_timeout;
+}
+
 ::size_t everest::connection::SerialDevice::read(unsigned char* buffer, ::size_t count) {
 
-    return ::ecs::read_from_device(m_fd, buffer, count, &get_serial_device_config().m_tty_config,
-                                   get_serial_device_config().initial_read_timeout_deciseconds,
-                                   get_serial_device_config().default_read_timeout_deciseconds);
+    // Within a frame of known length, a silence of t1.5 means the frame is broken. Otherwise only t3.5 of silence
+    // tells that the frame is complete.
+    const SerialDeviceConfiguration& config = get_serial_device_config();
+    const std::chrono::microseconds inter_byte_timeout =
+        std::max<std::chrono::microseconds>(read_timeout(config), m_frame_started ? config.t1_5() : config.t3_5());
+    ::size_t bytes_read = ::ecs::read_from_device(m_fd, buffer, count,
+                                                  m_frame_started ? inter_byte_timeout : initial_read_timeout(config),
+                                                  inter_byte_timeout);
+    if (bytes_read > 0)
+        m_line_idle_since = std::chrono::steady_clock::now();
+    return bytes_read;
+}
+
+::size_t everest::connection::SerialDevice::read_frame(unsigned char* buffer, ::size_t count,
+                                                      const FrameFormat& frame_format, ::size_t prefix_length) {
+
+    // read asks for exactly the missing bytes, so it returns as soon as they arrived instead of waiting for the
+    // inter byte timeout.
+    ::size_t frame_length = std::min(prefix_length + frame_format.header_length, count);
+    ::size_t bytes_read = read(buffer, frame_length);
+    if (bytes_read < frame_length)
+        return bytes_read; // timeout
+
+    ::size_t payload_length = frame_format.frame_length(buffer + prefix_length);
+    frame_length = payload_length == 0 ? count : std::min(prefix_length + payload_length, count);
+
+    // the rest of the frame follows its header without a pause, dont wait for it as long as for a response
+    m_frame_started = true;
+    try {
+        while (bytes_read < frame_length) {
+            ::size_t bytes_current = read(buffer + bytes_read, frame_length - bytes_read);
+            if (bytes_current == 0)
+                break;
+            bytes_read += bytes_current;
+        }
+    } catch (...) {
+        m_frame_started = false;
+        throw;
+    }
+    m_frame_started = false;
+    return bytes_read;
+}
+
+::size_t everest::connection::SerialDevice::flush_input_until_silent() {
+
+    const SerialDeviceConfiguration& config = get_serial_device_config();
+    const std::chrono::microseconds silence = std::max<std::chrono::microseconds>(read_timeout(config), config.t3_5());
+
+    unsigned char discarded[256];
+    ::size_t bytes_discarded = 0;
+    while (::size_t bytes_current = ::ecs::read_from_device(m_fd, discarded, sizeof(discarded), silence, silence))
+        bytes_discarded += bytes_current;
+
+    if (bytes_discarded > 0)
+        m_line_idle_since = std::chrono::steady_clock::now();
+    return bytes_discarded;
 }
 
 ::size_t everest::connection::SerialDeviceLogToStream::write(const unsigned char* const buffer, ::size_t count) {
@@ -122,9 +261,9 @@ void everest::connection::SerialDevice::drain() {
 
 ::size_t everest::connection::SerialDeviceLogToStream::read(unsigned char* buffer, ::size_t count) {
 
-    auto delay = get_serial_device_config().m_tty_config.c_cc[VTIME];
+    auto delay = initial_read_timeout(get_serial_device_config()).count();
     ::size_t bytes_read = SerialDevice::read(buffer, count);
-    (*m_stream) << get_serial_device_config().m_device << " read: \n with delay : " << (int)delay << "\n";
+    (*m_stream) << get_serial_device_config().m_device << " read: \n with delay : " << delay << "us\n";
     (*m_stream) << std::hex;
     for (::size_t index = 0; index < bytes_read; ++index)
         (*m_stream) << (unsigned)buffer[index] << " ";
@@ -243,43 +382,70 @@ void ecs::configure_device(int serial_port_fd, termios* tty) {
     return bytes_written_sum;
 }
 
-::ssize_t readByteFromDevice(int fd, unsigned char* charToRead) {
-
-    ssize_t read_result = ::read(fd, charToRead, 1);
-    if (not(read_result == -1))
-        return read_result;
-
-    int myerror = errno;
-    throw everest::connection::exceptions::tty::tty_error(
-        "Error: " + std::to_string(myerror) + " from ::read: " + strerror(myerror), myerror);
+// waits at most timeout for input on serial_port_fd, returns false on timeout. Throws
+// exceptions::communication_error if the device is closed or broken, ppoll would silently ignore a negative fd.
+static bool wait_for_input(int serial_port_fd, std::chrono::microseconds timeout) {
+
+    if (serial_port_fd < 0)
+        throw everest::connection::exceptions::communication_error("Error: read on closed serial device");
+
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    pollfd poll_fd{serial_port_fd, POLLIN, 0};
+
+    while (true) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline -
+                                                                                      std::chrono::steady_clock::now());
+        if (remaining.count() < 0)
+            return false;
+
+        const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+        const timespec poll_timeout{static_cast<time_t>(seconds.count()),
+                                    static_cast<long>((remaining - seconds).count() * 1000)};
+
+        int poll_result = ::ppoll(&poll_fd, 1, &poll_timeout, nullptr);
+        // a hang up still delivers the input received before it
+        const bool failed = (poll_fd.revents & (POLLERR | POLLNVAL)) or
+                            ((poll_fd.revents & POLLHUP) and not(poll_fd.revents & POLLIN));
+        if (poll_result > 0 and failed)
+            throw everest::connection::exceptions::communication_error(
+                "Error: serial device failed with poll events " + std::to_string(poll_fd.revents));
+        if (poll_result > 0)
+            return true;
+        if (poll_result == 0)
+            return false;
+        if (errno != EINTR) {
+            int myerror = errno;
+            throw everest::connection::exceptions::tty::tty_error(
+                "Error: " + std::to_string(myerror) + " from ::ppoll: " + strerror(myerror), myerror);
+        }
+    }
 }
 
-::size_t ecs::read_from_device(int serial_port_fd, unsigned char* buffer, ::size_t count, termios* tty_config,
-                               unsigned int initial_timeout_deciseconds, unsigned int timeout_deciseconds) {
+::size_t ecs::read_from_device(int serial_port_fd, unsigned char* buffer, ::size_t count,
+                               std::chrono::microseconds initial_timeout, std::chrono::microseconds timeout) {
 
     static_assert(std::is_unsigned<decltype(count)>::value, "need an unsigned type here. ");
-    update_timeout_configuration(tty_config, initial_timeout_deciseconds);
-    configure_device(serial_port_fd, tty_config);
-
-    if (count == 0)
-        return 0;
-
-    // read at least one byte
-    std::size_t index = 0;
-    ::size_t bytes_read = readByteFromDevice(serial_port_fd, &buffer[index++]);
-    if (bytes_read == 0)
-        return 0;
 
-    // dont wait that long after the end of transmission as it is done at the beginning.
-    update_timeout_configuration(tty_config, timeout_deciseconds);
-    configure_device(serial_port_fd, tty_config);
+    // wait long for the first byte, but dont wait that long after the end of transmission
+    std::chrono::microseconds current_timeout = initial_timeout;
+    ::size_t bytes_read = 0;
 
-    while (bytes_read < count) {
+    // drain everything available with one syscall instead of reading byte by byte
+    while (bytes_read < count and wait_for_input(serial_port_fd, current_timeout)) {
 
-        auto bytes_current = readByteFromDevice(serial_port_fd, &buffer[index++]);
+        ssize_t bytes_current = ::read(serial_port_fd, buffer + bytes_read, count - bytes_read);
+        if (bytes_current == -1) {
+            if (errno == EINTR or errno == EAGAIN)
+                continue;
+            int myerror = errno;
+            throw everest::connection::exceptions::tty::tty_error(
+                "Error: " + std::to_string(myerror) + " from ::read: " + strerror(myerror), myerror);
+        }
         if (bytes_current == 0)
-            return bytes_read;
+            break;
+
         bytes_read += bytes_current;
+        current_timeout = timeout;
     }
     return bytes_read;
 }
@@ -349,6 +515,47 @@ everest::connection::SerialDeviceConfiguration&
 everest::connection::SerialDeviceConfiguration::set_sensible_defaults() {
 
     ecs::set_default_configuration(&m_tty_config);
-    ecs::update_timeout_configuration(&m_tty_config, initial_read_timeout_deciseconds);
+    ecs::update_timeout_configuration(&m_tty_config, 0);
     return *this;
 }
+
+std::chrono::microseconds everest::connection::SerialDeviceConfiguration::character_time() const {
+
+    int data_bits = 8;
+    switch (m_tty_config.c_cflag & CSIZE) {
+    case CS5:
+        data_bits = 5;
+        break;
+    case CS6:
+        data_bits = 6;
+        break;
+    case CS7:
+        data_bits = 7;
+        break;
+    }
+    const int parity_bits = (m_tty_config.c_cflag & PARENB) ? 1 : 0;
+    const int stop_bits = (m_tty_config.c_cflag & CSTOPB) ? 2 : 1;
+    const int bits_per_character = 1 + data_bits + parity_bits + stop_bits;
+
+    const int baudrate = baudrate_to_integer(static_cast<BaudRate>(cfgetospeed(&m_tty_config)));
+    if (baudrate == 0)
+        return std::chrono::microseconds(0);
+
+    // round up, being silent a bit too long is harmless
+    return std::chrono::microseconds((bits_per_character * 1000000 + baudrate - 1) / baudrate);
+}
+
+std::chrono::microseconds everest::connection::SerialDeviceConfiguration::t1_5() const {
+
+    // the modbus over serial line specification recommends fixed values above 19200 baud
+    if (baudrate_to_integer(static_cast<BaudRate>(cfgetospeed(&m_tty_config))) > 19200)
+        return std::chrono::microseconds(750);
+    return character_time() * 3 / 2;
+}
+
+std::chrono::microseconds everest::connection::SerialDeviceConfiguration::t3_5() const {
+
+    if (baudrate_to_integer(static_cast<BaudRate>(cfgetospeed(&m_tty_config))) > 19200)
+        return std::chrono::microseconds(1750);
+    return character_time() * 7 / 2;
+}
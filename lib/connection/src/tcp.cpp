@@ -1,12 +1,20 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <algorithm>
 #include <arpa/inet.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
 #include <memory>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <sstream>
 #include <string>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <everest/logging.hpp>
@@ -17,20 +25,53 @@
 
 using namespace everest::connection;
 
-TCPConnection::TCPConnection(const std::string& address_, const int& port_) :
-    address(address_), port(port_), socket_fd(-1) {
+TCPConnection::TCPConnection(const std::string& address_, const int& port_,
+                             std::chrono::milliseconds connect_timeout_) :
+    TCPConnection(address_, port_, connect_timeout_, Deferred{}) {
     make_connection();
 }
 
+TCPConnection::TCPConnection(const std::string& address_, int port_, std::chrono::milliseconds connect_timeout_,
+                             Deferred) :
+    address(address_), port(port_), socket_fd(-1), connect_time_limit(connect_timeout_) {
+}
+
 TCPConnection::~TCPConnection() {
-    close_connection();
+    // the connection may have failed or been closed by the peer already
+    if (socket_fd != -1)
+        close_connection();
 }
 
 int TCPConnection::make_connection() {
 
+    if (not start_connect()) {
+        // the handshake is complete (or failed) once the socket is writable
+        const auto deadline = std::chrono::steady_clock::now() + connect_time_limit;
+        while (true) {
+            auto time_left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (time_left.count() <= 0)
+                std::rethrow_exception(connect_error("timed out", true));
+
+            struct pollfd poll_fd {};
+            poll_fd.fd = socket_fd;
+            poll_fd.events = POLLOUT;
+            int poll_result = poll(&poll_fd, 1, time_left.count());
+            if (poll_result == -1 and errno != EINTR)
+                std::rethrow_exception(connect_error(std::string("poll failed: ") + strerror(errno), false));
+            if (poll_result > 0)
+                break;
+        }
+        finish_connect();
+    }
+
+    return connection_status;
+}
+
+bool TCPConnection::start_connect() {
+
     // Opening socket locally
     EVLOG_debug << "Attempting to create TCP socket connection with endpoint " << address << ":" << port << ".";
-    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    socket_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
     if (socket_fd == -1) {
         std::stringstream error_message;
         error_message << "TCP Socket creation error while connecting to endpoint " << address << ":" << port << ".";
@@ -45,19 +86,115 @@ int TCPConnection::make_connection() {
     server_address.sin_port = htons(port);
     server_address.sin_addr.s_addr = inet_addr(address.c_str());
 
-    // Connecting
-    connection_status = connect(socket_fd, (struct sockaddr*)&server_address, sizeof(server_address));
-    if (connection_status == -1) {
-        std::stringstream error_message;
-        error_message << "TCP socket connection establishment failed while trying to reach endpoint " << address << ":"
-                      << port << ". fd = " << socket_fd;
-        EVLOG_error << error_message.str();
-        throw exceptions::tcp::tcp_connection_error(error_message.str());
+    // Connecting, a non-blocking socket returns before the handshake is done
+    if (connect(socket_fd, (struct sockaddr*)&server_address, sizeof(server_address)) == -1) {
+        if (errno != EINPROGRESS)
+            std::rethrow_exception(connect_error(strerror(errno), false));
+        return false;
     }
+    finish_connect();
+    return true;
+}
+
+void TCPConnection::finish_connect() {
+
+    int socket_error = 0;
+    socklen_t socket_error_length = sizeof(socket_error);
+    if (getsockopt(socket_fd, SOL_SOCKET, SO_ERROR, &socket_error, &socket_error_length) == -1)
+        socket_error = errno;
+    if (socket_error != 0)
+        std::rethrow_exception(connect_error(strerror(socket_error), false));
+
+    // the rest of the class relies on blocking sends and receives
+    int flags = fcntl(socket_fd, F_GETFL);
+    if (flags == -1 or fcntl(socket_fd, F_SETFL, flags & ~O_NONBLOCK) == -1)
+        std::rethrow_exception(connect_error(std::string("fcntl failed: ") + strerror(errno), false));
+    try {
+        apply_no_delay();
+    } catch (const std::runtime_error&) {
+        close(socket_fd);
+        socket_fd = -1;
+        throw;
+    }
+
+    connection_status = 0;
     EVLOG_debug << "Succesfully opened TCP socket connection with endpoint " << address << ":" << port
                 << ". fd = " << socket_fd;
+}
 
-    return connection_status;
+std::exception_ptr TCPConnection::connect_error(const std::string& reason, bool timed_out) {
+
+    std::stringstream error_message;
+    error_message << "TCP socket connection establishment failed while trying to reach endpoint " << address << ":"
+                  << port << ": " << reason;
+    EVLOG_error << error_message.str();
+
+    close(socket_fd);
+    socket_fd = -1;
+    connection_status = -1;
+    if (timed_out)
+        return std::make_exception_ptr(exceptions::timeout_error(error_message.str()));
+    return std::make_exception_ptr(exceptions::tcp::tcp_connection_error(error_message.str()));
+}
+
+std::vector<TCPConnection::ConnectResult> TCPConnection::connect_all(const std::vector<Endpoint>& endpoints,
+                                                                     std::chrono::milliseconds timeout) {
+
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::vector<ConnectResult> results;
+    std::vector<std::size_t> in_progress; // indices of the results still connecting
+    results.reserve(endpoints.size());
+    for (const Endpoint& endpoint : endpoints) {
+        results.push_back({std::unique_ptr<TCPConnection>(
+                               new TCPConnection(endpoint.address, endpoint.port, timeout, Deferred{})),
+                           nullptr});
+        try {
+            if (not results.back().connection->start_connect())
+                in_progress.push_back(results.size() - 1);
+        } catch (const std::runtime_error&) {
+            results.back().error = std::current_exception();
+        }
+    }
+
+    // one poll over all connects in progress, until they are done or the deadline has passed
+    std::vector<struct pollfd> poll_fds;
+    while (not in_progress.empty()) {
+        auto time_left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (time_left.count() <= 0)
+            break;
+
+        poll_fds.assign(in_progress.size(), pollfd{});
+        for (std::size_t index = 0; index < in_progress.size(); ++index) {
+            poll_fds[index].fd = results[in_progress[index]].connection->socket_fd;
+            poll_fds[index].events = POLLOUT;
+        }
+        int poll_result = poll(poll_fds.data(), poll_fds.size(), time_left.count());
+        if (poll_result == -1 and errno == EINTR)
+            continue;
+        if (poll_result == -1)
+            throw exceptions::tcp::tcp_connection_error(std::string("TCP connect_all - poll failed: ") +
+                                                        strerror(errno));
+
+        std::vector<std::size_t> still_in_progress;
+        for (std::size_t index = 0; index < in_progress.size(); ++index) {
+            ConnectResult& result = results[in_progress[index]];
+            if (poll_fds[index].revents == 0) {
+                still_in_progress.push_back(in_progress[index]);
+                continue;
+            }
+            try {
+                result.connection->finish_connect();
+            } catch (const std::runtime_error&) {
+                result.error = std::current_exception();
+            }
+        }
+        in_progress.swap(still_in_progress);
+    }
+
+    for (std::size_t index : in_progress)
+        results[index].error = results[index].connection->connect_error("timed out", true);
+
+    return results;
 }
 
 int TCPConnection::close_connection() {
@@ -74,6 +211,7 @@ int TCPConnection::close_connection() {
     EVLOG_debug << "Closed socket with fd = " << socket_fd << ".";
     socket_fd = -1;
     connection_status = -1;
+    receive_buffer.clear();
     return close_status;
 }
 
@@ -84,6 +222,10 @@ bool TCPConnection::is_valid() const {
 }
 
 int TCPConnection::send_bytes(const std::vector<uint8_t>& bytes_to_send) {
+    return send_bytes(bytes_to_send.data(), bytes_to_send.size());
+}
+
+int TCPConnection::send_bytes(const uint8_t* bytes_to_send, std::size_t count) {
 
     if (!is_valid()) {
         std::stringstream error_message;
@@ -92,25 +234,156 @@ int TCPConnection::send_bytes(const std::vector<uint8_t>& bytes_to_send) {
         throw exceptions::tcp::tcp_connection_error(error_message.str());
     }
 
-    int message_len = bytes_to_send.size();
+    int message_len = count;
     EVLOG_debug << "Attempting to send message to " << address << ":" << port << " - "
-                << utils::get_bytes_hex_string(bytes_to_send) << "- Size = " << message_len;
+                << utils::get_bytes_hex_string(bytes_to_send, count) << "- Size = " << message_len;
+
+    // Trying to send, a short write is continued with the remaining bytes
+    std::size_t bytes_sent = 0;
+    while (bytes_sent < count) {
+        // a closed peer makes this throw instead of raising SIGPIPE
+        ssize_t sent = send(socket_fd, bytes_to_send + bytes_sent, count - bytes_sent, MSG_NOSIGNAL);
+        if (sent == -1 and errno == EINTR)
+            continue;
+        if (sent == -1) {
+            std::stringstream error_message;
+            error_message << "MODBUS TCP - Error while sending message: "
+                          << utils::get_bytes_hex_string(bytes_to_send, count) << ", " << bytes_sent
+                          << " bytes were sent.";
+            EVLOG_error << error_message.str();
+            throw exceptions::communication_error(error_message.str());
+        }
+        bytes_sent += sent;
+    }
 
-    // Trying to send
-    int bytes_sent = send(socket_fd, (unsigned char*)bytes_to_send.data(), message_len, 0);
-    if (bytes_sent == -1) {
+    EVLOG_debug << "Successfully sent " << bytes_sent << " bytes.";
+    return bytes_sent;
+}
+
+int TCPConnection::send_buffers(const ConstBuffer* buffers, std::size_t num_buffers) {
+
+    if (!is_valid()) {
         std::stringstream error_message;
-        error_message << "MODBUS TCP - Error while sending message: " << bytes_to_send.data();
+        error_message << "MODBUS TCP - No connection established with " << address << ":" << port << ".";
         EVLOG_error << error_message.str();
-        throw exceptions::communication_error(error_message.str());
+        throw exceptions::tcp::tcp_connection_error(error_message.str());
+    }
+
+    std::vector<iovec> vectors(num_buffers);
+    std::size_t message_len = 0;
+    for (std::size_t index = 0; index < num_buffers; ++index) {
+        vectors[index].iov_base = const_cast<uint8_t*>(buffers[index].data);
+        vectors[index].iov_len = buffers[index].size;
+        message_len += buffers[index].size;
+    }
+    EVLOG_debug << "Attempting to send " << num_buffers << " buffers to " << address << ":" << port
+                << " - Size = " << message_len;
+
+    // a large batch may be accepted partially, the rest is sent starting behind the last byte taken
+    std::size_t first_vector = 0;
+    std::size_t bytes_sent = 0;
+    while (bytes_sent < message_len) {
+        struct msghdr message {};
+        message.msg_iov = vectors.data() + first_vector;
+        message.msg_iovlen = std::min<std::size_t>(vectors.size() - first_vector, IOV_MAX);
+
+        // a closed peer makes this throw instead of raising SIGPIPE
+        ssize_t sent = sendmsg(socket_fd, &message, MSG_NOSIGNAL);
+        if (sent == -1 and errno == EINTR)
+            continue;
+        if (sent == -1) {
+            std::stringstream error_message;
+            error_message << "MODBUS TCP - Error while sending " << message_len << " bytes in " << num_buffers
+                          << " buffers, " << bytes_sent << " bytes were sent.";
+            EVLOG_error << error_message.str();
+            throw exceptions::communication_error(error_message.str());
+        }
+
+        bytes_sent += sent;
+        for (; first_vector < vectors.size() and std::size_t(sent) >= vectors[first_vector].iov_len; ++first_vector)
+            sent -= vectors[first_vector].iov_len;
+        if (first_vector < vectors.size()) {
+            vectors[first_vector].iov_base = static_cast<uint8_t*>(vectors[first_vector].iov_base) + sent;
+            vectors[first_vector].iov_len -= sent;
+        }
     }
 
     EVLOG_debug << "Successfully sent " << bytes_sent << " bytes.";
     return bytes_sent;
 }
 
+void TCPConnection::set_no_delay(bool no_delay) {
+    no_delay_enabled = no_delay;
+    if (is_valid())
+        apply_no_delay();
+}
+
+void TCPConnection::apply_no_delay() {
+
+    int option = no_delay_enabled ? 1 : 0;
+    if (setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option)) == -1) {
+        std::stringstream error_message;
+        error_message << "Failed to set TCP_NODELAY on socket with fd = " << socket_fd << ".";
+        EVLOG_error << error_message.str();
+        throw exceptions::tcp::tcp_connection_error(error_message.str());
+    }
+}
+
+bool TCPConnection::wait_for_data(std::chrono::milliseconds timeout) {
+    return not receive_buffer.empty() or wait_for_socket(timeout);
+}
+
+bool TCPConnection::wait_for_socket(std::chrono::milliseconds timeout) {
+
+    if (!is_valid()) {
+        std::stringstream error_message;
+        error_message << "No connection established with " << address << ":" << port << ".";
+        EVLOG_error << error_message.str();
+        throw exceptions::tcp::tcp_connection_error(error_message.str());
+    }
+
+    struct pollfd poll_fd {};
+    poll_fd.fd = socket_fd;
+    poll_fd.events = POLLIN;
+
+    int poll_result = poll(&poll_fd, 1, std::clamp<std::chrono::milliseconds::rep>(timeout.count(), 0, INT_MAX));
+    if (poll_result == -1) {
+        // interrupted by a signal, let the caller recheck its deadlines
+        if (errno == EINTR)
+            return false;
+        std::stringstream error_message;
+        error_message << "MODBUS TCP - Error while waiting for data from " << address << ":" << port << ".";
+        EVLOG_error << error_message.str();
+        throw exceptions::communication_error(error_message.str());
+    }
+
+    return poll_result > 0;
+}
+
 std::vector<uint8_t> TCPConnection::receive_bytes(unsigned int number_of_bytes) {
 
+    std::vector<uint8_t> received_bytes(number_of_bytes);
+    received_bytes.resize(receive_bytes(received_bytes.data(), received_bytes.size()));
+    return received_bytes;
+}
+
+// a negative timeout never expires
+static std::chrono::steady_clock::time_point deadline_after(std::chrono::milliseconds timeout) {
+    if (timeout.count() < 0)
+        return std::chrono::steady_clock::time_point::max();
+    return std::chrono::steady_clock::now() + timeout;
+}
+
+static std::chrono::milliseconds time_left_until(std::chrono::steady_clock::time_point deadline) {
+    return std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+}
+
+std::size_t TCPConnection::receive_bytes(uint8_t* buffer, std::size_t count) {
+    return receive_bytes(buffer, count, receive_time_limit);
+}
+
+std::size_t TCPConnection::receive_bytes(uint8_t* buffer, std::size_t count, std::chrono::milliseconds timeout) {
+
     if (!is_valid()) {
         std::stringstream error_message;
         error_message << "No connection established with " << address << ":" << port << ".";
@@ -118,21 +391,126 @@ std::vector<uint8_t> TCPConnection::receive_bytes(unsigned int number_of_bytes)
         throw exceptions::tcp::tcp_connection_error(error_message.str());
     }
 
-    // Attempting to receive
-    std::vector<uint8_t> received_bytes;
-    received_bytes.reserve(number_of_bytes);
-    uint8_t response_buffer[number_of_bytes];
+    // bytes buffered by receive_frame() come first
+    if (not receive_buffer.empty()) {
+        const std::size_t num_bytes = std::min(count, receive_buffer.size());
+        std::copy(receive_buffer.begin(), receive_buffer.begin() + num_bytes, buffer);
+        receive_buffer.erase(receive_buffer.begin(), receive_buffer.begin() + num_bytes);
+        return num_bytes;
+    }
+
+    const auto deadline = deadline_after(timeout);
+    while (not wait_for_socket(time_left_until(deadline))) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            std::stringstream error_message;
+            error_message << "MODBUS TCP - No bytes received from " << address << ":" << port << " within "
+                          << timeout.count() << " ms.";
+            EVLOG_debug << error_message.str();
+            throw exceptions::timeout_error(error_message.str());
+        }
+    }
 
-    int num_bytes_received = recv(socket_fd, &response_buffer, sizeof(response_buffer), 0);
+    // Attempting to receive
+    int num_bytes_received = recv(socket_fd, buffer, count, 0);
     if (num_bytes_received == -1) {
         EVLOG_error << "No bytes received from " << address << ":" << port
-                    << ". Closing connection and returning preallocated buffer.";
+                    << ". Closing connection and returning empty buffer.";
         close_connection();
-        return received_bytes;
+        return 0;
     }
 
-    received_bytes.assign(response_buffer, response_buffer + num_bytes_received);
-    EVLOG_debug << received_bytes.size() << " bytes received from " << address << ":" << port << " - "
-                << utils::get_bytes_hex_string(received_bytes);
-    return received_bytes;
+    EVLOG_debug << num_bytes_received << " bytes received from " << address << ":" << port << " - "
+                << utils::get_bytes_hex_string(buffer, num_bytes_received);
+    return num_bytes_received;
+}
+
+std::size_t TCPConnection::take_frame(uint8_t* buffer, std::size_t count, const FrameFormat& frame_format,
+                                      std::size_t prefix_length) {
+
+    if (receive_buffer.size() < prefix_length + frame_format.header_length)
+        return 0;
+
+    const std::size_t frame_length = frame_format.frame_length(receive_buffer.data() + prefix_length);
+    const std::size_t frame_size = prefix_length + frame_length;
+    if (frame_length == 0 or frame_size > count) {
+        // nothing behind this can be trusted
+        receive_buffer.clear();
+        std::stringstream error_message;
+        error_message << "MODBUS TCP - Invalid frame length " << frame_length << " received from " << address << ":"
+                      << port << ", stream out of sync.";
+        EVLOG_error << error_message.str();
+        throw exceptions::communication_error(error_message.str());
+    }
+    if (receive_buffer.size() < frame_size)
+        return 0;
+
+    std::copy(receive_buffer.begin(), receive_buffer.begin() + frame_size, buffer);
+    receive_buffer.erase(receive_buffer.begin(), receive_buffer.begin() + frame_size);
+    return frame_size;
+}
+
+bool TCPConnection::fill_receive_buffer() {
+
+    // large enough for many replies per call
+    constexpr std::size_t chunk_size = 4096;
+    const std::size_t buffered = receive_buffer.size();
+    receive_buffer.resize(buffered + chunk_size);
+
+    ssize_t num_bytes_received;
+    do {
+        num_bytes_received = recv(socket_fd, receive_buffer.data() + buffered, chunk_size, 0);
+    } while (num_bytes_received == -1 and errno == EINTR);
+
+    if (num_bytes_received <= 0) {
+        receive_buffer.resize(buffered);
+        EVLOG_error << "Connection to " << address << ":" << port << " closed while receiving. Closing socket.";
+        close_connection();
+        return false;
+    }
+
+    receive_buffer.resize(buffered + num_bytes_received);
+    EVLOG_debug << num_bytes_received << " bytes received from " << address << ":" << port << " - "
+                << utils::get_bytes_hex_string(receive_buffer.data() + buffered, num_bytes_received);
+    return true;
+}
+
+std::size_t TCPConnection::receive_frame(uint8_t* buffer, std::size_t count, const FrameFormat& frame_format,
+                                         std::size_t prefix_length) {
+
+    std::size_t frame_size =
+        receive_frame_until(buffer, count, frame_format, prefix_length, deadline_after(receive_time_limit));
+    if (frame_size == 0 and is_valid()) {
+        std::stringstream error_message;
+        error_message << "MODBUS TCP - No complete frame received from " << address << ":" << port << " within "
+                      << receive_time_limit.count() << " ms.";
+        EVLOG_debug << error_message.str();
+        throw exceptions::timeout_error(error_message.str());
+    }
+    return frame_size;
+}
+
+std::size_t TCPConnection::receive_frame(uint8_t* buffer, std::size_t count, const FrameFormat& frame_format,
+                                         std::chrono::milliseconds timeout) {
+    return receive_frame_until(buffer, count, frame_format, 0, deadline_after(timeout));
+}
+
+std::size_t TCPConnection::receive_frame_until(uint8_t* buffer, std::size_t count, const FrameFormat& frame_format,
+                                               std::size_t prefix_length,
+                                               std::chrono::steady_clock::time_point deadline) {
+
+    while (true) {
+        std::size_t frame_size = take_frame(buffer, count, frame_format, prefix_length);
+        if (frame_size > 0)
+            return frame_size;
+        if (not is_valid())
+            return 0;
+
+        if (not wait_for_socket(time_left_until(deadline))) {
+            if (std::chrono::steady_clock::now() >= deadline)
+                return 0;
+            continue;
+        }
+        if (not fill_receive_buffer())
+            return 0;
+    }
 }
@@ -1,12 +1,17 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <algorithm>
 #include <arpa/inet.h>
+#include <cerrno>
+#include <climits>
 #include <memory>
 #include <netinet/in.h>
+#include <poll.h>
 #include <sstream>
 #include <string>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <everest/logging.hpp>
@@ -84,6 +89,10 @@ bool UDPConnection::is_valid() const {
 }
 
 int UDPConnection::send_bytes(const std::vector<uint8_t>& bytes_to_send) {
+    return send_bytes(bytes_to_send.data(), bytes_to_send.size());
+}
+
+int UDPConnection::send_bytes(const uint8_t* bytes_to_send, std::size_t count) {
 
     if (!is_valid()) {
         std::stringstream error_message;
@@ -92,16 +101,52 @@ int UDPConnection::send_bytes(const std::vector<uint8_t>& bytes_to_send) {
         throw exceptions::udp::udp_socket_error(error_message.str());
     }
 
-    int message_len = bytes_to_send.size();
+    int message_len = count;
     EVLOG_debug << "Attempting to send message to " << address << ":" << port << " - "
-                << utils::get_bytes_hex_string(bytes_to_send) << "- Size = " << message_len;
+                << utils::get_bytes_hex_string(bytes_to_send, count) << "- Size = " << message_len;
 
     // Trying to send
-    int bytes_sent = sendto(socket_fd, (unsigned char*)bytes_to_send.data(), message_len, 0, (struct sockaddr*)NULL,
-                            sizeof(struct sockaddr));
+    int bytes_sent =
+        sendto(socket_fd, bytes_to_send, message_len, 0, (struct sockaddr*)NULL, sizeof(struct sockaddr));
+    if (bytes_sent == -1) {
+        std::stringstream error_message;
+        error_message << "MODBUS UDP - Error while sending message: "
+                      << utils::get_bytes_hex_string(bytes_to_send, count);
+        EVLOG_error << error_message.str();
+        throw exceptions::communication_error(error_message.str());
+    }
+
+    EVLOG_debug << "Successfully sent " << bytes_sent << " bytes.";
+    return bytes_sent;
+}
+
+static std::vector<iovec> make_vectors(const ConstBuffer* buffers, std::size_t num_buffers) {
+    std::vector<iovec> vectors(num_buffers);
+    for (std::size_t index = 0; index < num_buffers; ++index) {
+        vectors[index].iov_base = const_cast<uint8_t*>(buffers[index].data);
+        vectors[index].iov_len = buffers[index].size;
+    }
+    return vectors;
+}
+
+int UDPConnection::send_buffers(const ConstBuffer* buffers, std::size_t num_buffers) {
+
+    if (!is_valid()) {
+        std::stringstream error_message;
+        error_message << "MODBUS UDP - No connection established with " << address << ":" << port << ".";
+        EVLOG_error << error_message.str();
+        throw exceptions::udp::udp_socket_error(error_message.str());
+    }
+
+    std::vector<iovec> vectors = make_vectors(buffers, num_buffers);
+    struct msghdr message {};
+    message.msg_iov = vectors.data();
+    message.msg_iovlen = vectors.size();
+
+    int bytes_sent = sendmsg(socket_fd, &message, 0);
     if (bytes_sent == -1) {
         std::stringstream error_message;
-        error_message << "MODBUS UDP - Error while sending message: " << bytes_to_send.data();
+        error_message << "MODBUS UDP - Error while sending a datagram of " << num_buffers << " buffers.";
         EVLOG_error << error_message.str();
         throw exceptions::communication_error(error_message.str());
     }
@@ -110,8 +155,56 @@ int UDPConnection::send_bytes(const std::vector<uint8_t>& bytes_to_send) {
     return bytes_sent;
 }
 
+int UDPConnection::send_datagrams(const ConstBuffer* datagrams, std::size_t num_datagrams) {
+
+    if (!is_valid()) {
+        std::stringstream error_message;
+        error_message << "MODBUS UDP - No connection established with " << address << ":" << port << ".";
+        EVLOG_error << error_message.str();
+        throw exceptions::udp::udp_socket_error(error_message.str());
+    }
+
+    std::vector<iovec> vectors = make_vectors(datagrams, num_datagrams);
+    std::vector<mmsghdr> messages(num_datagrams);
+    for (std::size_t index = 0; index < num_datagrams; ++index) {
+        messages[index].msg_hdr.msg_iov = &vectors[index];
+        messages[index].msg_hdr.msg_iovlen = 1;
+    }
+    EVLOG_debug << "Attempting to send " << num_datagrams << " datagrams to " << address << ":" << port << ".";
+
+    // sendmmsg may stop early, e.g. when the socket buffer is full
+    std::size_t datagrams_sent = 0;
+    while (datagrams_sent < num_datagrams) {
+        int sent = sendmmsg(socket_fd, messages.data() + datagrams_sent, num_datagrams - datagrams_sent, 0);
+        if (sent == -1 and errno == EINTR)
+            continue;
+        if (sent == -1) {
+            std::stringstream error_message;
+            error_message << "MODBUS UDP - Error while sending " << num_datagrams << " datagrams, " << datagrams_sent
+                          << " were sent.";
+            EVLOG_error << error_message.str();
+            throw exceptions::communication_error(error_message.str());
+        }
+        datagrams_sent += sent;
+    }
+
+    EVLOG_debug << "Successfully sent " << datagrams_sent << " datagrams.";
+    return datagrams_sent;
+}
+
 std::vector<uint8_t> UDPConnection::receive_bytes(unsigned int number_of_bytes) {
 
+    std::vector<uint8_t> received_bytes(number_of_bytes);
+    received_bytes.resize(receive_bytes(received_bytes.data(), received_bytes.size()));
+    return received_bytes;
+}
+
+std::size_t UDPConnection::receive_bytes(uint8_t* buffer, std::size_t count) {
+    return receive_bytes(buffer, count, receive_time_limit);
+}
+
+std::size_t UDPConnection::receive_bytes(uint8_t* buffer, std::size_t count, std::chrono::milliseconds timeout) {
+
     if (!is_valid()) {
         std::stringstream error_message;
         error_message << "No connection established with " << address << ":" << port << ".";
@@ -119,22 +212,86 @@ std::vector<uint8_t> UDPConnection::receive_bytes(unsigned int number_of_bytes)
         throw exceptions::udp::udp_socket_error(error_message.str());
     }
 
-    // Attempting to receive
-    std::vector<uint8_t> received_bytes;
-    received_bytes.reserve(number_of_bytes);
-    uint8_t response_buffer[number_of_bytes];
+    // a lost datagram must not block forever, a negative timeout does. A datagram that is queued already is
+    // returned even when the deadline has passed, so the deadline is only checked once poll found nothing.
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (timeout.count() >= 0) {
+        auto time_left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+        struct pollfd poll_fd {};
+        poll_fd.fd = socket_fd;
+        poll_fd.events = POLLIN;
+        int poll_result =
+            poll(&poll_fd, 1, std::clamp<std::chrono::milliseconds::rep>(time_left.count(), 0, INT_MAX));
+        if (poll_result > 0 or (poll_result == -1 and errno != EINTR))
+            // an error is reported by recvfrom
+            break;
+
+        if (poll_result == 0 and time_left.count() <= 0) {
+            std::stringstream error_message;
+            error_message << "MODBUS UDP - No datagram received from " << address << ":" << port << " within "
+                          << timeout.count() << " ms.";
+            EVLOG_debug << error_message.str();
+            throw exceptions::timeout_error(error_message.str());
+        }
+    }
 
-    int num_bytes_received =
-        recvfrom(socket_fd, &response_buffer, sizeof(response_buffer), 0, (struct sockaddr*)NULL, NULL);
+    // Attempting to receive
+    int num_bytes_received = recvfrom(socket_fd, buffer, count, 0, (struct sockaddr*)NULL, NULL);
     if (num_bytes_received == -1) {
         EVLOG_error << "No bytes received from " << address << ":" << port
-                    << ". Closing connection and returning preallocated buffer.";
+                    << ". Closing connection and returning empty buffer.";
         close_connection();
-        return received_bytes;
+        return 0;
     }
 
-    received_bytes.assign(response_buffer, response_buffer + num_bytes_received);
-    EVLOG_debug << received_bytes.size() << " bytes received from " << address << ":" << port << " - "
-                << utils::get_bytes_hex_string(received_bytes);
-    return received_bytes;
+    EVLOG_debug << num_bytes_received << " bytes received from " << address << ":" << port << " - "
+                << utils::get_bytes_hex_string(buffer, num_bytes_received);
+    return num_bytes_received;
+}
+
+std::size_t UDPConnection::receive_datagrams(MutableBuffer* buffers, std::size_t num_buffers,
+                                             std::chrono::milliseconds timeout) {
+
+    if (!is_valid()) {
+        std::stringstream error_message;
+        error_message << "No connection established with " << address << ":" << port << ".";
+        EVLOG_error << error_message.str();
+        throw exceptions::udp::udp_socket_error(error_message.str());
+    }
+
+    struct pollfd poll_fd {};
+    poll_fd.fd = socket_fd;
+    poll_fd.events = POLLIN;
+    int poll_result = poll(&poll_fd, 1, std::clamp<std::chrono::milliseconds::rep>(timeout.count(), 0, INT_MAX));
+    if (poll_result <= 0)
+        // timed out or interrupted by a signal, the caller rechecks its deadline
+        return 0;
+
+    std::vector<iovec> vectors(num_buffers);
+    std::vector<mmsghdr> messages(num_buffers);
+    for (std::size_t index = 0; index < num_buffers; ++index) {
+        vectors[index].iov_base = buffers[index].data;
+        vectors[index].iov_len = buffers[index].size;
+        messages[index].msg_hdr.msg_iov = &vectors[index];
+        messages[index].msg_hdr.msg_iovlen = 1;
+    }
+
+    // takes only what is queued already, the wait is done by poll
+    int num_received = recvmmsg(socket_fd, messages.data(), num_buffers, MSG_DONTWAIT, nullptr);
+    if (num_received == -1) {
+        // ECONNREFUSED reports an ICMP error queued for an earlier datagram, recvmmsg has cleared it. Datagrams
+        // still queued are taken by the next call and unanswered requests run into the caller's deadline.
+        if (errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR or errno == ECONNREFUSED)
+            return 0;
+        std::stringstream error_message;
+        error_message << "MODBUS UDP - Error while receiving datagrams from " << address << ":" << port << ".";
+        EVLOG_error << error_message.str();
+        throw exceptions::communication_error(error_message.str());
+    }
+
+    for (int index = 0; index < num_received; ++index)
+        buffers[index].size = messages[index].msg_len;
+    EVLOG_debug << num_received << " datagrams received from " << address << ":" << port << ".";
+    return num_received;
 }
@@ -5,9 +5,13 @@
 using namespace everest::connection;
 
 std::string utils::get_bytes_hex_string(const std::vector<uint8_t>& bytes) {
+    return get_bytes_hex_string(bytes.data(), bytes.size());
+}
+
+std::string utils::get_bytes_hex_string(const uint8_t* bytes, std::size_t count) {
     std::stringstream buffer;
-    for (auto it = bytes.begin(); it != bytes.end(); it++) {
-        buffer << std::hex << (int)*it << " ";
+    for (std::size_t index = 0; index < count; index++) {
+        buffer << std::hex << (int)bytes[index] << " ";
     }
     return buffer.str();
 }
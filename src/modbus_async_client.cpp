@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+
+#include <array>
+
+#include <consts.hpp>
+#include <modbus/modbus_async_client.hpp>
+#include <modbus/utils.hpp>
+
+using namespace everest::modbus;
+
+void ModbusAsyncIPClient::async_read_holding_register(uint8_t unit_id, uint16_t first_register_address,
+                                                      uint16_t num_registers_to_read, ResultCallback callback) {
+    async_read(consts::READ_HOLDING_REGISTER_FUNCTION_CODE, unit_id, first_register_address, num_registers_to_read,
+               std::move(callback));
+}
+
+void ModbusAsyncIPClient::async_read_input_register(uint8_t unit_id, uint16_t first_register_address,
+                                                    uint16_t num_registers_to_read, ResultCallback callback) {
+    async_read(consts::READ_INPUT_REGISTER_FUNCTION_CODE, unit_id, first_register_address, num_registers_to_read,
+               std::move(callback));
+}
+
+void ModbusAsyncIPClient::async_write_multiple_registers(uint8_t unit_id, uint16_t first_register_address,
+                                                         uint16_t num_registers_to_write,
+                                                         const ModbusDataContainerUint16& payload,
+                                                         ResultCallback callback) {
+
+    std::vector<uint8_t> request(consts::tcp::MAX_ADU);
+    std::size_t pdu_size = utils::encode_write_multiple_register_body(
+        ByteSpan(request).subspan(consts::tcp::MBAP_HEADER_LENGTH), first_register_address, num_registers_to_write,
+        payload);
+    request.resize(utils::ip::encode_adu(request, m_next_transaction_id++, unit_id, pdu_size));
+    submit(std::move(request), false, std::move(callback));
+}
+
+void ModbusAsyncIPClient::async_read(uint8_t function_code, uint8_t unit_id, uint16_t first_register_address,
+                                     uint16_t num_registers_to_read, ResultCallback callback) {
+
+    std::vector<uint8_t> request(consts::tcp::MAX_ADU);
+    std::size_t pdu_size =
+        utils::encode_read_command_message_body(ByteSpan(request).subspan(consts::tcp::MBAP_HEADER_LENGTH),
+                                                function_code, first_register_address, num_registers_to_read);
+    request.resize(utils::ip::encode_adu(request, m_next_transaction_id++, unit_id, pdu_size));
+    submit(std::move(request), true, std::move(callback));
+}
+
+void ModbusAsyncIPClient::submit(std::vector<uint8_t> request, bool return_only_registers_bytes,
+                                 ResultCallback callback) {
+
+    // MBAP header and function code of the request, the response is validated against them
+    std::array<uint8_t, consts::tcp::MBAP_HEADER_LENGTH + 1> request_header;
+    std::copy(request.begin(), request.begin() + request_header.size(), request_header.begin());
+
+    auto complete = [request_header, return_only_registers_bytes,
+                     callback = std::move(callback)](std::vector<uint8_t> response, std::exception_ptr error) {
+        if (not error) {
+            try {
+                utils::ip::check_mbap_header(request_header, response);
+                if (return_only_registers_bytes) {
+                    ConstByteSpan register_bytes = utils::view_registers_bytes_from_response_body(
+                        ConstByteSpan(response).subspan(consts::tcp::MBAP_HEADER_LENGTH - 1));
+                    response = std::vector<uint8_t>(register_bytes.begin(), register_bytes.end());
+                }
+            } catch (const std::exception&) {
+                error = std::current_exception();
+                response.clear();
+            }
+        }
+        callback(std::move(response), error);
+    };
+
+    m_loop.submit(m_endpoint, std::move(request), std::move(complete), m_transaction_timeout);
+}
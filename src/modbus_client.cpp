@@ -1,8 +1,12 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <algorithm>
+#include <string>
+
 #include <everest/logging.hpp>
 
 #include <consts.hpp>
+#include <modbus/exceptions.hpp>
 #include <modbus/modbus_client.hpp>
 #include <modbus/utils.hpp>
 
@@ -15,16 +19,96 @@ ModbusClient::ModbusClient(connection::Connection& conn_) : conn(conn_) {
 const std::vector<uint8_t> ModbusClient::read_holding_register(uint8_t unit_id, uint16_t first_register_address,
                                                                uint16_t num_registers_to_read,
                                                                bool return_only_registers_bytes) const {
-    std::vector<uint8_t> body =
-        utils::build_read_holding_register_message_body(first_register_address, num_registers_to_read);
-    std::vector<uint8_t> full_message =
-        full_message_from_body(body, consts::READ_REGISTER_COMMAND_LENGTH, unit_id);
-    conn.send_bytes(full_message);
-    std::vector<uint8_t> response = conn.receive_bytes(max_adu_size());
-    int num_register_bytes = validate_response(response, full_message);
+    if (num_registers_to_read > consts::MAX_REGISTERS_PER_READ and return_only_registers_bytes) {
+        std::vector<uint8_t> registers(2 * num_registers_to_read);
+        read_registers_into(consts::READ_HOLDING_REGISTER_FUNCTION_CODE, unit_id, first_register_address,
+                            num_registers_to_read, registers);
+        return registers;
+    }
+
+    AduBuffer request;
+    ConstByteSpan response = transceive(encode_read_request(request, consts::READ_HOLDING_REGISTER_FUNCTION_CODE,
+                                                            unit_id, first_register_address, num_registers_to_read));
 
     if (return_only_registers_bytes)
-        return utils::extract_register_bytes_from_response(response, num_register_bytes);
+        response = register_bytes_of_response(response);
+
+    return std::vector<uint8_t>(response.begin(), response.end());
+}
+
+ConstByteSpan ModbusClient::read_holding_register_view(uint8_t unit_id, uint16_t first_register_address,
+                                                       uint16_t num_registers_to_read) const {
+    AduBuffer request;
+    return register_bytes_of_response(transceive(encode_read_request(
+        request, consts::READ_HOLDING_REGISTER_FUNCTION_CODE, unit_id, first_register_address, num_registers_to_read)));
+}
+
+std::size_t ModbusClient::read_holding_register_into(uint8_t unit_id, uint16_t first_register_address,
+                                                     uint16_t num_registers_to_read, ByteSpan destination) const {
+    return read_registers_into(consts::READ_HOLDING_REGISTER_FUNCTION_CODE, unit_id, first_register_address,
+                               num_registers_to_read, destination);
+}
+
+std::size_t ModbusClient::read_registers_into(uint8_t function_code, uint8_t unit_id, uint16_t first_register_address,
+                                              uint16_t num_registers_to_read, ByteSpan destination) const {
+
+    const std::size_t num_bytes = 2 * num_registers_to_read;
+    if (destination.size() < num_bytes)
+        throw exceptions::message_size_exception("Reading " + std::to_string(num_registers_to_read) +
+                                                 " registers into a buffer of " + std::to_string(destination.size()) +
+                                                 " bytes.");
+    if (first_register_address + num_registers_to_read > 0x10000)
+        throw exceptions::message_size_exception("Reading " + std::to_string(num_registers_to_read) +
+                                                 " registers from " + std::to_string(first_register_address) +
+                                                 " exceeds the register address range.");
+
+    read_register_chunks(function_code, unit_id, first_register_address, num_registers_to_read,
+                         destination.subspan(0, num_bytes));
+    return num_bytes;
+}
+
+void ModbusClient::read_register_chunks(uint8_t function_code, uint8_t unit_id, uint16_t first_register_address,
+                                        uint16_t num_registers_to_read, ByteSpan destination) const {
+
+    for (uint16_t offset = 0; offset < num_registers_to_read;) {
+        const uint16_t chunk = std::min<uint16_t>(num_registers_to_read - offset, consts::MAX_REGISTERS_PER_READ);
+        AduBuffer request;
+        ConstByteSpan registers = register_bytes_of_response(
+            transceive(encode_read_request(request, function_code, unit_id, first_register_address + offset, chunk)));
+        if (registers.size() != 2u * chunk)
+            throw exceptions::unmatched_response("Expected " + std::to_string(2 * chunk) + " register bytes, got " +
+                                                 std::to_string(registers.size()) + ".");
 
+        std::copy(registers.begin(), registers.end(), destination.begin() + 2 * offset);
+        offset += chunk;
+    }
+}
+
+ConstByteSpan ModbusClient::transceive(ConstByteSpan request) const {
+    conn.send_bytes(request.data(), request.size());
+    ConstByteSpan response(m_response_buffer.data(), conn.receive_bytes(m_response_buffer.data(), max_adu_size()));
+    validate_response(response, request);
     return response;
 }
+
+ConstByteSpan ModbusClient::register_bytes_of_response(ConstByteSpan response) const {
+    // the response body starts with the unit id, right in front of the PDU
+    return utils::view_registers_bytes_from_response_body(response.subspan(pdu_offset() - 1));
+}
+
+ConstByteSpan ModbusClient::encode_read_request(AduBuffer& buffer, uint8_t function_code, uint8_t unit_id,
+                                                uint16_t first_register_address,
+                                                uint16_t num_registers_to_read) const {
+    std::size_t pdu_size = utils::encode_read_command_message_body(
+        ByteSpan(buffer).subspan(pdu_offset()), function_code, first_register_address, num_registers_to_read);
+    return ConstByteSpan(buffer.data(), encode_adu(buffer, pdu_size, unit_id));
+}
+
+ConstByteSpan ModbusClient::encode_write_multiple_registers_request(AduBuffer& buffer, uint8_t unit_id,
+                                                                    uint16_t first_register_address,
+                                                                    uint16_t num_registers_to_write,
+                                                                    const ModbusDataContainerUint16& payload) const {
+    std::size_t pdu_size = utils::encode_write_multiple_register_body(
+        ByteSpan(buffer).subspan(pdu_offset()), first_register_address, num_registers_to_write, payload);
+    return ConstByteSpan(buffer.data(), encode_adu(buffer, pdu_size, unit_id));
+}
@@ -1,5 +1,14 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <string>
+
+#include <everest/logging.hpp>
+
+#include <consts.hpp>
+#include <modbus/exceptions.hpp>
 #include <modbus/modbus_client.hpp>
 #include <modbus/utils.hpp>
 
@@ -11,7 +20,7 @@ ModbusIPClient::ModbusIPClient(connection::Connection& conn_) : ModbusClient(con
 const std::vector<uint8_t> ModbusIPClient::full_message_from_body(const std::vector<uint8_t>& body,
                                                                   uint16_t message_length, uint8_t unit_id) const {
     // Creates and prepend MBAP header
-    std::vector<uint8_t> mbap_header = utils::ip::make_mbap_header(message_length, unit_id);
+    std::vector<uint8_t> mbap_header = utils::ip::make_mbap_header(next_transaction_id(), message_length, unit_id);
     std::vector<uint8_t> full_message;
     full_message.reserve(mbap_header.size() + body.size());
     full_message.insert(full_message.end(), mbap_header.begin(), mbap_header.end());
@@ -19,12 +28,253 @@ const std::vector<uint8_t> ModbusIPClient::full_message_from_body(const std::vec
     return full_message;
 }
 
-uint16_t ModbusIPClient::validate_response(const std::vector<uint8_t>& response,
-                                           const std::vector<uint8_t>& request) const {
+uint16_t ModbusIPClient::validate_response(ConstByteSpan response, ConstByteSpan request) const {
     return modbus::utils::ip::check_mbap_header(request, response);
 }
 
-ModbusTCPClient::ModbusTCPClient(connection::TCPConnection& conn_) : ModbusIPClient(conn_) {
+static const ::everest::connection::FrameFormat mbap_frame_format{utils::ip::FRAME_HEADER_LENGTH,
+                                                                  utils::ip::frame_length};
+
+ConstByteSpan ModbusIPClient::transceive(ConstByteSpan request) const {
+    conn.send_bytes(request.data(), request.size());
+
+    // Datagram connections receive whole ADUs anyway. Replies to earlier requests that timed out may still arrive
+    // before the one to this request, they are dropped. Each receive is bounded by the receive timeout.
+    while (true) {
+        ConstByteSpan response(m_response_buffer.data(),
+                               conn.receive_frame(m_response_buffer.data(), max_adu_size(), mbap_frame_format, 0));
+        if (response.size() >= consts::tcp::MBAP_HEADER_LENGTH and
+            utils::ip::get_transaction_id(response) != utils::ip::get_transaction_id(request)) {
+            EVLOG_debug << "MODBUS IP - Discarding late reply with transaction id "
+                        << utils::ip::get_transaction_id(response);
+            continue;
+        }
+        validate_response(response, request);
+        return response;
+    }
+}
+
+std::size_t ModbusIPClient::encode_adu(ByteSpan buffer, std::size_t pdu_size, uint8_t unit_id) const {
+    return utils::ip::encode_adu(buffer, next_transaction_id(), unit_id, pdu_size);
+}
+
+ModbusTCPClient::ModbusTCPClient(connection::TCPConnection& conn_) : ModbusIPClient(conn_), tcp_conn(conn_) {
+}
+
+void ModbusTCPClient::set_pipeline_window(std::size_t window) {
+    // transaction ids of requests in flight have to be unique
+    m_pipeline_window = std::clamp<std::size_t>(window, 1, std::numeric_limits<uint16_t>::max());
+}
+
+static std::vector<uint8_t> register_bytes_from_frame(const std::vector<uint8_t>& frame) {
+
+    // MBAP header, function code, byte count
+    const std::size_t register_bytes_offset = consts::tcp::MBAP_HEADER_LENGTH + 2;
+    if (frame.size() < register_bytes_offset || frame.size() < register_bytes_offset + frame[register_bytes_offset - 1])
+        throw exceptions::unmatched_response("MODBUS TCP - Byte count exceeds the size of the response.");
+
+    return std::vector<uint8_t>(frame.begin() + register_bytes_offset,
+                                frame.begin() + register_bytes_offset + frame[register_bytes_offset - 1]);
+}
+
+std::vector<ModbusTCPClient::TransactionResult>
+ModbusTCPClient::read_registers_pipelined(const std::vector<ReadRequest>& requests,
+                                          bool return_only_registers_bytes) const {
+
+    using clock = std::chrono::steady_clock;
+
+    struct InFlight {
+        std::size_t request_index{0};
+        AduBuffer request{};
+        std::size_t request_size{0};
+        clock::time_point deadline{};
+    };
+
+    std::vector<TransactionResult> results(requests.size());
+    std::map<uint16_t, InFlight> in_flight; // keyed by transaction id
+    std::size_t next_request = 0;
+    AduBuffer frame_buffer;
+    std::vector<connection::ConstBuffer> messages;
+
+    while (next_request < requests.size() || not in_flight.empty()) {
+
+        // the requests filling up the window go out with a single send
+        messages.clear();
+        while (in_flight.size() < m_pipeline_window && next_request < requests.size()) {
+            const ReadRequest& request = requests[next_request];
+
+            InFlight transaction{next_request};
+            ConstByteSpan message = encode_read_request(transaction.request, request.function_code, request.unit_id,
+                                                        request.first_register_address, request.num_registers_to_read);
+            transaction.request_size = message.size();
+            transaction.deadline = clock::now() + m_transaction_timeout;
+
+            const InFlight& queued = in_flight[utils::ip::get_transaction_id(message)] = transaction;
+            messages.push_back({queued.request.data(), queued.request_size});
+            ++next_request;
+        }
+        if (not messages.empty())
+            conn.send_buffers(messages.data(), messages.size());
+
+        auto earliest_deadline = std::min_element(in_flight.cbegin(), in_flight.cend(), [](auto& lhs, auto& rhs) {
+                                     return lhs.second.deadline < rhs.second.deadline;
+                                 })->second.deadline;
+        auto time_left = std::chrono::ceil<std::chrono::milliseconds>(earliest_deadline - clock::now());
+        std::size_t frame_size = tcp_conn.receive_frame(frame_buffer.data(), frame_buffer.size(), mbap_frame_format,
+                                                        std::max(time_left, std::chrono::milliseconds(0)));
+
+        if (frame_size == 0 and not tcp_conn.is_valid()) {
+            // the connection was closed, neither the transactions in flight nor the queued ones can complete.
+            auto error = std::make_exception_ptr(
+                exceptions::empty_response("MODBUS TCP - Connection closed while transactions were in flight."));
+            for (auto& transaction : in_flight)
+                results[transaction.second.request_index].error = error;
+            for (; next_request < requests.size(); ++next_request)
+                results[next_request].error = error;
+            break;
+        }
+
+        // dispatch the reply, replies without a transaction in flight arrived after their timeout
+        if (frame_size > 0) {
+            std::vector<uint8_t> frame(frame_buffer.begin(), frame_buffer.begin() + frame_size);
+            auto transaction = in_flight.find(utils::ip::get_transaction_id(frame));
+            if (transaction == in_flight.end()) {
+                EVLOG_debug << "MODBUS TCP - Discarding reply with unknown transaction id "
+                            << utils::ip::get_transaction_id(frame);
+            } else {
+                TransactionResult& result = results[transaction->second.request_index];
+                try {
+                    utils::ip::check_mbap_header(
+                        ConstByteSpan(transaction->second.request.data(), transaction->second.request_size), frame);
+                    result.response = return_only_registers_bytes ? register_bytes_from_frame(frame) : frame;
+                } catch (const std::runtime_error&) {
+                    result.error = std::current_exception();
+                }
+                in_flight.erase(transaction);
+            }
+        }
+
+        // also after a discarded reply, a stream of late replies must not keep expired transactions alive
+
+        const clock::time_point now = clock::now();
+        for (auto transaction = in_flight.begin(); transaction != in_flight.end();) {
+            if (transaction->second.deadline <= now) {
+                results[transaction->second.request_index].error = std::make_exception_ptr(
+                    exceptions::transaction_timeout("MODBUS TCP - No reply for transaction id " +
+                                                    std::to_string(transaction->first) + " within timeout."));
+                transaction = in_flight.erase(transaction);
+            } else {
+                ++transaction;
+            }
+        }
+    }
+
+    return results;
+}
+
+void ModbusTCPClient::read_register_chunks(uint8_t function_code, uint8_t unit_id, uint16_t first_register_address,
+                                           uint16_t num_registers_to_read, ByteSpan destination) const {
+
+    std::vector<ReadRequest> chunks;
+    for (uint32_t offset = 0; offset < num_registers_to_read; offset += consts::MAX_REGISTERS_PER_READ) {
+        const uint16_t chunk = std::min<uint32_t>(num_registers_to_read - offset, consts::MAX_REGISTERS_PER_READ);
+        chunks.push_back({unit_id, static_cast<uint16_t>(first_register_address + offset), chunk, function_code});
+    }
+
+    std::vector<TransactionResult> results = read_registers_pipelined(chunks);
+    for (std::size_t index = 0; index < chunks.size(); ++index) {
+        if (results[index].error)
+            std::rethrow_exception(results[index].error);
+        const std::vector<uint8_t>& registers = results[index].response;
+        if (registers.size() != 2u * chunks[index].num_registers_to_read)
+            throw exceptions::unmatched_response("MODBUS TCP - Expected " +
+                                                 std::to_string(2 * chunks[index].num_registers_to_read) +
+                                                 " register bytes, got " + std::to_string(registers.size()) + ".");
+        std::copy(registers.begin(), registers.end(),
+                  destination.begin() + 2 * (chunks[index].first_register_address - first_register_address));
+    }
+}
+
+ModbusUDPClient::ModbusUDPClient(connection::UDPConnection& conn_) : ModbusIPClient(conn_), udp_conn(conn_) {
 }
-ModbusUDPClient::ModbusUDPClient(connection::UDPConnection& conn_) : ModbusIPClient(conn_) {
+
+// transaction ids of a batch have to be unique, more requests are sent in several batches
+static constexpr std::size_t max_requests_per_batch = 64;
+
+std::vector<ModbusUDPClient::TransactionResult>
+ModbusUDPClient::read_registers_batched(const std::vector<ReadRequest>& requests,
+                                        bool return_only_registers_bytes) const {
+
+    using clock = std::chrono::steady_clock;
+
+    struct Pending {
+        std::size_t request_index;
+        std::size_t request_size;
+    };
+
+    std::vector<TransactionResult> results(requests.size());
+    std::vector<AduBuffer> request_buffers(std::min(requests.size(), max_requests_per_batch));
+    std::vector<AduBuffer> reply_buffers(request_buffers.size());
+    std::vector<connection::ConstBuffer> datagrams;
+    std::vector<connection::MutableBuffer> replies;
+
+    for (std::size_t first_request = 0; first_request < requests.size(); first_request += max_requests_per_batch) {
+        const std::size_t batch_size = std::min(requests.size() - first_request, max_requests_per_batch);
+
+        std::map<uint16_t, Pending> pending; // keyed by transaction id
+        datagrams.clear();
+        for (std::size_t index = 0; index < batch_size; ++index) {
+            const ReadRequest& request = requests[first_request + index];
+            ConstByteSpan message =
+                encode_read_request(request_buffers[index], request.function_code, request.unit_id,
+                                    request.first_register_address, request.num_registers_to_read);
+            pending[utils::ip::get_transaction_id(message)] = {first_request + index, message.size()};
+            datagrams.push_back({message.data(), message.size()});
+        }
+        udp_conn.send_datagrams(datagrams.data(), datagrams.size());
+
+        const clock::time_point deadline = clock::now() + m_transaction_timeout;
+        while (not pending.empty()) {
+            auto time_left = std::chrono::ceil<std::chrono::milliseconds>(deadline - clock::now());
+            if (time_left.count() <= 0)
+                break;
+
+            replies.clear();
+            for (AduBuffer& buffer : reply_buffers)
+                replies.push_back({buffer.data(), buffer.size()});
+            std::size_t num_replies = udp_conn.receive_datagrams(replies.data(), replies.size(), time_left);
+
+            // replies without a pending transaction belong to an earlier batch and arrived after its timeout
+            for (std::size_t reply_index = 0; reply_index < num_replies; ++reply_index) {
+                std::vector<uint8_t> frame(replies[reply_index].data,
+                                           replies[reply_index].data + replies[reply_index].size);
+                auto transaction =
+                    frame.size() < utils::ip::FRAME_HEADER_LENGTH ? pending.end()
+                                                                  : pending.find(utils::ip::get_transaction_id(frame));
+                if (transaction == pending.end()) {
+                    EVLOG_debug << "MODBUS UDP - Discarding reply of " << frame.size() << " bytes without request";
+                    continue;
+                }
+
+                const std::size_t request_index = transaction->second.request_index;
+                TransactionResult& result = results[request_index];
+                try {
+                    utils::ip::check_mbap_header(ConstByteSpan(request_buffers[request_index - first_request].data(),
+                                                               transaction->second.request_size),
+                                                 frame);
+                    result.response = return_only_registers_bytes ? register_bytes_from_frame(frame) : frame;
+                } catch (const std::runtime_error&) {
+                    result.error = std::current_exception();
+                }
+                pending.erase(transaction);
+            }
+        }
+
+        for (auto& transaction : pending)
+            results[transaction.second.request_index].error = std::make_exception_ptr(
+                exceptions::transaction_timeout("MODBUS UDP - No reply for transaction id " +
+                                                std::to_string(transaction.first) + " within timeout."));
+    }
+
+    return results;
 }
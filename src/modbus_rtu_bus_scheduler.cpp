@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <algorithm>
+#include <exception>
+#include <string>
+
+#include <everest/logging.hpp>
+
+#include <modbus/exceptions.hpp>
+#include <modbus/modbus_rtu_bus_scheduler.hpp>
+
+using namespace everest::modbus;
+
+static std::string suspended_message(uint8_t unit_id) {
+    return "MODBUS RTU bus scheduler - unit " + std::to_string(unit_id) + " is suspended, it did not respond";
+}
+
+ModbusRTUBusScheduler::ModbusRTUBusScheduler(connection::RTUConnection& connection, bool ignore_echo) :
+    m_client(connection, ignore_echo) {
+    m_worker = std::thread([this]() { run(); });
+}
+
+ModbusRTUBusScheduler::~ModbusRTUBusScheduler() {
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop_requested = true;
+    }
+    m_jobs_queued.notify_one();
+    m_worker.join();
+}
+
+std::future<DataVectorUint8> ModbusRTUBusScheduler::submit(uint8_t unit_id, Transaction transaction,
+                                                           Priority priority) {
+
+    Job job{std::move(transaction), {}};
+    std::future<DataVectorUint8> result = job.result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Unit& unit = m_units[unit_id];
+        if (suspended(unit, std::chrono::steady_clock::now())) {
+            job.result.set_exception(std::make_exception_ptr(exceptions::unit_suspended(suspended_message(unit_id))));
+            return result;
+        }
+        unit.queues[static_cast<std::size_t>(priority)].push_back(std::move(job));
+        ++m_num_queued_jobs;
+    }
+    m_jobs_queued.notify_one();
+    return result;
+}
+
+std::future<DataVectorUint8> ModbusRTUBusScheduler::read_holding_register(uint8_t unit_id,
+                                                                          uint16_t first_register_address,
+                                                                          uint16_t num_registers_to_read,
+                                                                          Priority priority) {
+    return submit(
+        unit_id,
+        [unit_id, first_register_address, num_registers_to_read](const ModbusRTUClient& client) {
+            return client.read_holding_register(unit_id, first_register_address, num_registers_to_read);
+        },
+        priority);
+}
+
+std::future<DataVectorUint8> ModbusRTUBusScheduler::read_input_register(uint8_t unit_id,
+                                                                        uint16_t first_register_address,
+                                                                        uint16_t num_registers_to_read,
+                                                                        Priority priority) {
+    return submit(
+        unit_id,
+        [unit_id, first_register_address, num_registers_to_read](const ModbusRTUClient& client) {
+            return client.read_input_register(unit_id, first_register_address, num_registers_to_read);
+        },
+        priority);
+}
+
+std::future<DataVectorUint8> ModbusRTUBusScheduler::write_multiple_registers(uint8_t unit_id,
+                                                                             uint16_t first_register_address,
+                                                                             uint16_t num_registers_to_write,
+                                                                             const ModbusDataContainerUint16& payload,
+                                                                             Priority priority) {
+    return submit(
+        unit_id,
+        [unit_id, first_register_address, num_registers_to_write, payload](const ModbusRTUClient& client) {
+            return client.write_multiple_registers(unit_id, first_register_address, num_registers_to_write, payload,
+                                                   false);
+        },
+        priority);
+}
+
+void ModbusRTUBusScheduler::set_suspension(unsigned int failures, std::chrono::milliseconds initial_suspension,
+                                           std::chrono::milliseconds max_suspension) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_failures_until_suspension = std::max(failures, 1u);
+    m_initial_suspension = initial_suspension;
+    m_max_suspension = std::max(max_suspension, initial_suspension);
+}
+
+unsigned int ModbusRTUBusScheduler::failures_until_suspension() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failures_until_suspension;
+}
+
+bool ModbusRTUBusScheduler::is_suspended(uint8_t unit_id) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto unit = m_units.find(unit_id);
+    return unit != m_units.end() and suspended(unit->second, std::chrono::steady_clock::now());
+}
+
+void ModbusRTUBusScheduler::run() {
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_jobs_queued.wait(lock, [this]() { return m_stop_requested or m_num_queued_jobs > 0; });
+        if (m_stop_requested)
+            return;
+
+        uint8_t unit_id;
+        Job job = next_job(unit_id);
+        lock.unlock();
+
+        DataVectorUint8 result;
+        std::exception_ptr error;
+        bool responded = true;
+        try {
+            result = job.transaction(m_client);
+        } catch (const exceptions::empty_response&) {
+            responded = false;
+            error = std::current_exception();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // the state of the unit is updated before the result is handed out
+        lock.lock();
+        update_unit(unit_id, responded);
+        if (error)
+            job.result.set_exception(error);
+        else
+            job.result.set_value(std::move(result));
+    }
+}
+
+void ModbusRTUBusScheduler::update_unit(uint8_t unit_id, bool responded) {
+
+    Unit& unit = m_units[unit_id];
+    if (responded) {
+        unit.consecutive_failures = 0;
+        unit.suspension = std::chrono::milliseconds(0);
+        return;
+    }
+
+    if (++unit.consecutive_failures < m_failures_until_suspension)
+        return;
+    // the first suspension, or the unit stayed silent after the last one
+    unit.suspension =
+        unit.suspension.count() == 0 ? m_initial_suspension : std::min(2 * unit.suspension, m_max_suspension);
+    unit.suspended_until = std::chrono::steady_clock::now() + unit.suspension;
+    EVLOG_warning << "MODBUS RTU bus scheduler - unit " << static_cast<int>(unit_id) << " did not respond "
+                  << unit.consecutive_failures << " times, suspended for " << unit.suspension.count() << " ms";
+    fail_queued_jobs(unit_id, unit);
+}
+
+ModbusRTUBusScheduler::Job ModbusRTUBusScheduler::next_job(uint8_t& unit_id) {
+
+    for (std::size_t priority = 0; priority < NUM_PRIORITIES; ++priority) {
+        // round robin: start behind the unit served last in this class
+        auto unit = m_last_unit_id[priority] < 0 ? m_units.begin()
+                                                 : m_units.upper_bound(static_cast<uint8_t>(m_last_unit_id[priority]));
+        for (std::size_t step = 0; step < m_units.size(); ++step, ++unit) {
+            if (unit == m_units.end())
+                unit = m_units.begin();
+            std::deque<Job>& queue = unit->second.queues[priority];
+            if (queue.empty())
+                continue;
+
+            Job job = std::move(queue.front());
+            queue.pop_front();
+            --m_num_queued_jobs;
+            unit_id = unit->first;
+            m_last_unit_id[priority] = unit_id;
+            return job;
+        }
+    }
+
+    throw exceptions::should_never_happen("MODBUS RTU bus scheduler - no queued job found");
+}
+
+void ModbusRTUBusScheduler::fail_queued_jobs(uint8_t unit_id, Unit& unit) {
+
+    for (std::deque<Job>& queue : unit.queues) {
+        for (Job& job : queue)
+            job.result.set_exception(std::make_exception_ptr(exceptions::unit_suspended(suspended_message(unit_id))));
+        m_num_queued_jobs -= queue.size();
+        queue.clear();
+    }
+}
@@ -2,6 +2,7 @@
 // Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
 #include <algorithm>
 #include <consts.hpp>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -40,35 +41,50 @@ union SwapIt {
 
 DataVectorUint8 ModbusRTUClient::response_without_protocol_data(const DataVectorUint8& raw_response,
                                                                 std::size_t payload_length) {
-    // strip address and function bytes, but include bytecount byte
+    ConstByteSpan payload = view_without_protocol_data(raw_response, payload_length);
+    return DataVectorUint8(payload.begin(), payload.end());
+}
+
+ConstByteSpan ModbusRTUClient::view_without_protocol_data(ConstByteSpan raw_response, std::size_t payload_length) {
+    // strip address, function and bytecount bytes
     const int offset_protocol_bytes{3};
-    return DataVectorUint8(raw_response.cbegin() + offset_protocol_bytes,
-                           raw_response.cbegin() + offset_protocol_bytes + payload_length);
+    return raw_response.subspan(offset_protocol_bytes, payload_length);
+}
+
+static const ::everest::connection::FrameFormat response_frame_format{utils::rtu::RESPONSE_HEADER_LENGTH,
+                                                                      utils::rtu::response_frame_length};
+
+static void check_num_registers_to_read(uint16_t num_registers_to_read, const std::string& function) {
+
+    if (num_registers_to_read > everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE)
+        throw everest::modbus::exceptions::message_size_exception(
+            function + " Requested number of 16 bit registers " + std::to_string(num_registers_to_read) +
+            " would exceed allowed message size of " +
+            std::to_string(everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE) + " registers ");
 }
 
 const DataVectorUint8 ModbusRTUClient::read_holding_register(uint8_t unit_id, uint16_t first_register_address,
                                                              uint16_t num_registers_to_read,
                                                              bool return_only_registers_bytes) const {
 
-    using namespace std::string_literals;
-
 #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
 
-    if (num_registers_to_read > everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE)
-        throw everest::modbus::exceptions::message_size_exception(
-            ""s + __PRETTY_FUNCTION__ + " Requested number of 16 bit registers " +
-            std::to_string(num_registers_to_read) + " would exceed allowed message size of " +
-            std::to_string(everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE) + " registers ");
+    if (num_registers_to_read > consts::MAX_REGISTERS_PER_READ and return_only_registers_bytes) {
+        DataVectorUint8 registers(2 * num_registers_to_read);
+        read_registers_into(consts::READ_HOLDING_REGISTER_FUNCTION_CODE, unit_id, first_register_address,
+                            num_registers_to_read, registers);
+        return registers;
+    }
+    check_num_registers_to_read(num_registers_to_read, __PRETTY_FUNCTION__);
 
-    DataVectorUint8 body =
-        utils::build_read_holding_register_message_body(first_register_address, num_registers_to_read);
+    AduBuffer request;
+    ConstByteSpan response = transceive(encode_read_request(request, consts::READ_HOLDING_REGISTER_FUNCTION_CODE,
+                                                            unit_id, first_register_address, num_registers_to_read));
 
-    DataVectorUint8 full_message = full_message_from_body(body, consts::READ_REGISTER_COMMAND_LENGTH, unit_id);
+    if (return_only_registers_bytes)
+        response = view_without_protocol_data(response, response.at(2));
 
-    conn.send_bytes(full_message);
-    modbus::DataVectorUint8 response = conn.receive_bytes(max_adu_size());
-    uint16_t payload_size = validate_response(response, full_message);
-    return return_only_registers_bytes ? response_without_protocol_data(response, payload_size) : response;
+    return DataVectorUint8(response.begin(), response.end());
 
 #else
 
@@ -77,52 +93,126 @@ const DataVectorUint8 ModbusRTUClient::read_holding_register(uint8_t unit_id, ui
 #endif
 }
 
+ConstByteSpan ModbusRTUClient::read_holding_register_view(uint8_t unit_id, uint16_t first_register_address,
+                                                          uint16_t num_registers_to_read) const {
+
+    check_num_registers_to_read(num_registers_to_read, __PRETTY_FUNCTION__);
+
+    AduBuffer request;
+    ConstByteSpan response = transceive(encode_read_request(request, consts::READ_HOLDING_REGISTER_FUNCTION_CODE,
+                                                            unit_id, first_register_address, num_registers_to_read));
+    return view_without_protocol_data(response, response.at(2));
+}
+
 // HACK: is not a virtual function, not implementing the modbus interface.
 const DataVectorUint8 ModbusRTUClient::read_input_register(uint8_t unit_id, uint16_t first_register_address,
                                                            uint16_t num_registers_to_read,
                                                            bool return_only_registers_bytes) const {
 
-    std::vector<uint8_t> body =
-        utils::build_read_input_register_message_body(first_register_address, num_registers_to_read);
-    std::vector<uint8_t> full_message = full_message_from_body(body, consts::READ_REGISTER_COMMAND_LENGTH, unit_id);
-    conn.send_bytes(full_message);
-    std::vector<uint8_t> response = conn.receive_bytes(max_adu_size());
-
-    if (ignore_echo && response.size() > full_message.size()) {
-        auto request = std::vector<uint8_t>(response.begin(), response.begin() + full_message.size());
-        if (full_message == request) {
-            response = std::vector<uint8_t>(response.begin() + full_message.size(), response.end());
-        }
+    if (num_registers_to_read > consts::MAX_REGISTERS_PER_READ and return_only_registers_bytes) {
+        DataVectorUint8 registers(2 * num_registers_to_read);
+        read_registers_into(consts::READ_INPUT_REGISTER_FUNCTION_CODE, unit_id, first_register_address,
+                            num_registers_to_read, registers);
+        return registers;
     }
+    check_num_registers_to_read(num_registers_to_read, __PRETTY_FUNCTION__);
 
-    int num_register_bytes = validate_response(response, full_message);
+    AduBuffer request;
+    ConstByteSpan response = transceive(encode_read_request(request, consts::READ_INPUT_REGISTER_FUNCTION_CODE,
+                                                            unit_id, first_register_address, num_registers_to_read));
 
-    if (return_only_registers_bytes) {
-        return utils::extract_register_bytes_from_response(response, num_register_bytes + 2);
-    }
+    if (return_only_registers_bytes)
+        response = view_without_protocol_data(response, response.at(2));
+
+    return DataVectorUint8(response.begin(), response.end());
+}
 
+ConstByteSpan ModbusRTUClient::read_input_register_view(uint8_t unit_id, uint16_t first_register_address,
+                                                        uint16_t num_registers_to_read) const {
+
+    check_num_registers_to_read(num_registers_to_read, __PRETTY_FUNCTION__);
+
+    AduBuffer request;
+    ConstByteSpan response = transceive(encode_read_request(request, consts::READ_INPUT_REGISTER_FUNCTION_CODE,
+                                                            unit_id, first_register_address, num_registers_to_read));
+    return view_without_protocol_data(response, response.at(2));
+}
+
+ConstByteSpan ModbusRTUClient::transceive(ConstByteSpan request) const {
+
+    conn.send_bytes(request.data(), request.size());
+    // stop reading at the end of the response instead of waiting for the line to become idle
+    ConstByteSpan response = ignore_echo ? receive_response_after_echo(request)
+                                         : ConstByteSpan(m_response_buffer.data(),
+                                                         conn.receive_frame(m_response_buffer.data(), max_adu_size(),
+                                                                            response_frame_format, 0));
+    validate_response(response, request);
     return response;
 }
 
+ConstByteSpan ModbusRTUClient::receive_response_after_echo(ConstByteSpan request) const {
+
+    // Some rs485 adapters echo the request in front of the response, others dont. The header tells which one arrived,
+    // unless the request happens to start like its response, then the whole echo has to match.
+    uint8_t* buffer = m_response_buffer.data();
+    const std::size_t header_length = response_frame_format.header_length;
+    std::size_t bytes_received = conn.receive_bytes(buffer, header_length);
+    if (bytes_received < header_length)
+        return ConstByteSpan(buffer, bytes_received); // timeout
+
+    if (std::equal(buffer, buffer + header_length, request.begin())) {
+        if (bytes_received < request.size())
+            bytes_received += conn.receive_bytes(buffer + bytes_received, request.size() - bytes_received);
+
+        if (bytes_received >= request.size() and std::equal(request.begin(), request.end(), buffer)) {
+            // keep what arrived behind the echo
+            bytes_received -= request.size();
+            std::memmove(buffer, buffer + request.size(), bytes_received);
+            if (bytes_received == 0)
+                return ConstByteSpan(buffer, conn.receive_frame(buffer, max_adu_size(), response_frame_format, 0));
+            if (bytes_received < header_length)
+                bytes_received += conn.receive_bytes(buffer + bytes_received, header_length - bytes_received);
+            if (bytes_received < header_length)
+                return ConstByteSpan(buffer, bytes_received);
+        }
+    }
+
+    // the rest of a response, which has started already
+    std::size_t frame_length = utils::rtu::response_frame_length(buffer);
+    frame_length = frame_length == 0 ? max_adu_size() : std::min(frame_length, max_adu_size());
+    while (bytes_received < frame_length) {
+        std::size_t bytes_current = conn.receive_bytes(buffer + bytes_received, frame_length - bytes_received);
+        if (bytes_current == 0)
+            break;
+        bytes_received += bytes_current;
+    }
+    return ConstByteSpan(buffer, bytes_received);
+}
+
 DataVectorUint8 ModbusDataContainerUint16::get_payload_as_bigendian() const {
 
-    DataVectorUint8 result;
-    result.reserve(m_payload.size() * sizeof(DataVectorUint16::value_type));
+    DataVectorUint8 result(m_payload.size() * sizeof(DataVectorUint16::value_type));
+    copy_payload_as_bigendian(result);
+    return result;
+}
+
+std::size_t ModbusDataContainerUint16::copy_payload_as_bigendian(ByteSpan buffer) const {
+
+    using namespace std::string_literals;
+
+    const std::size_t payload_size = m_payload.size() * sizeof(DataVectorUint16::value_type);
+    if (buffer.size() < payload_size)
+        throw everest::modbus::exceptions::message_size_exception(
+            ""s + __PRETTY_FUNCTION__ + " payload of " + std::to_string(payload_size) +
+            " bytes does not fit into buffer of " + std::to_string(buffer.size()) + " bytes.");
 
+    // a little endian payload holds the values in host order, a big endian one is in register byte order already
     if (m_byte_order == ByteOrder::LittleEndian)
-        for (uint16_t value : m_payload) {
-            SwapIt s{value};
-            result.push_back(s.value_8.hi);
-            result.push_back(s.value_8.low);
-        }
+        utils::registers_to_big_endian(buffer.data(), m_payload.data(), m_payload.size());
     else
-        for (uint16_t value : m_payload) {
-            SwapIt s{value};
-            result.push_back(s.value_8.low);
-            result.push_back(s.value_8.hi);
-        }
+        std::memcpy(buffer.data(), m_payload.data(), payload_size);
 
-    return result;
+    return payload_size;
 }
 
 DataVectorUint8 everest::modbus::ModbusRTUClient::write_multiple_registers(uint8_t unit_id,
@@ -135,20 +225,34 @@ DataVectorUint8 everest::modbus::ModbusRTUClient::write_multiple_registers(uint8
 
     using namespace std::string_literals;
 
-    if (num_registers_to_write > everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE)
-        throw everest::modbus::exceptions::message_size_exception(
-            ""s + __PRETTY_FUNCTION__ + " Requested number of 16 bit registers " +
-            std::to_string(num_registers_to_write) + " would exceed allowed message size of " +
-            std::to_string(everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE) + " registers !");
+    ConstByteSpan response;
+    if (num_registers_to_write <= consts::MAX_REGISTERS_PER_WRITE) {
+        AduBuffer request;
+        response = transceive(encode_write_multiple_registers_request(request, unit_id, first_register_address,
+                                                                      num_registers_to_write, payload));
+    } else {
+        // the payload is converted once, each request takes its part of the register bytes
+        if (payload.size() < num_registers_to_write or first_register_address + num_registers_to_write > 0x10000)
+            throw everest::modbus::exceptions::message_size_exception(
+                ""s + __PRETTY_FUNCTION__ + " Requested number of 16 bit registers " +
+                std::to_string(num_registers_to_write) + " exceeds the payload or the register address range !");
+        DataVectorUint8 register_bytes = payload.get_payload_as_bigendian();
+
+        for (uint16_t offset = 0; offset < num_registers_to_write;) {
+            const uint16_t chunk = std::min<uint16_t>(num_registers_to_write - offset, consts::MAX_REGISTERS_PER_WRITE);
+            AduBuffer request;
+            std::size_t pdu_size = utils::encode_write_multiple_register_body(
+                ByteSpan(request).subspan(pdu_offset()), first_register_address + offset, chunk,
+                ConstByteSpan(register_bytes).subspan(2 * offset, 2 * chunk));
+            response = transceive(ConstByteSpan(request.data(), encode_adu(request, pdu_size, unit_id)));
+            offset += chunk;
+        }
+    }
 
-    DataVectorUint8 body =
-        utils::build_write_multiple_register_body(first_register_address, num_registers_to_write, payload);
-    DataVectorUint8 full_message = full_message_from_body(body, body.size() /* unused parameter */, unit_id);
+    if (return_only_registers_bytes)
+        response = view_without_protocol_data(response, response.at(2));
 
-    conn.send_bytes(full_message);
-    modbus::DataVectorUint8 response = conn.receive_bytes(max_adu_size());
-    uint16_t payload_size = validate_response(response, full_message);
-    return return_only_registers_bytes ? response_without_protocol_data(response, payload_size) : response;
+    return DataVectorUint8(response.begin(), response.end());
 
 #else
 
@@ -177,8 +281,11 @@ const everest::modbus::DataVectorUint8 ModbusRTUClient::full_message_from_body(c
     return full_message;
 }
 
-uint16_t everest::modbus::ModbusRTUClient::validate_response(const DataVectorUint8& response,
-                                                             const DataVectorUint8& request) const {
+std::size_t ModbusRTUClient::encode_adu(ByteSpan buffer, std::size_t pdu_size, uint8_t unit_id) const {
+    return utils::rtu::encode_adu(buffer, unit_id, pdu_size);
+}
+
+uint16_t everest::modbus::ModbusRTUClient::validate_response(ConstByteSpan response, ConstByteSpan request) const {
 
     using namespace std::string_literals;
 
@@ -242,14 +349,8 @@ uint16_t everest::modbus::ModbusRTUClient::validate_response(const DataVectorUin
         throw everest::modbus::exceptions::unmatched_response(""s + __PRETTY_FUNCTION__ +
                                                               " request / response function id mismatch. ");
 
-    SwapIt crcResponseCalculated;
-    crcResponseCalculated.value_16 = ::everest::modbus::utils::calcCRC_16_ANSI(response.data(), response.size() - 2);
-
-    SwapIt crcResponseData;
-    crcResponseData.value_8.hi = response.at(response.size() - 2);
-    crcResponseData.value_8.low = response.at(response.size() - 1);
-
-    if (crcResponseCalculated.value_16 != crcResponseData.value_16)
+    // the crc over the whole response including its crc bytes has to be zero
+    if (not ::everest::modbus::utils::Crc16Modbus().update(response.data(), response.size()).frame_valid())
         throw everest::modbus::exceptions::checksum_error(""s + __PRETTY_FUNCTION__ + " checksum error ");
 
     uint16_t result_size = response.at(2);
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <everest/logging.hpp>
+
+#include <consts.hpp>
+#include <modbus/modbus_server.hpp>
+#include <modbus/utils.hpp>
+
+using namespace everest::modbus;
+
+static const ::everest::connection::FrameFormat request_frame_format{utils::rtu::REQUEST_HEADER_LENGTH,
+                                                                     utils::rtu::request_frame_length};
+
+ModbusRTUServer::ModbusRTUServer(RegisterBank& bank, connection::SerialDevice& device,
+                                 const std::vector<uint8_t>& unit_ids, bool ignore_echo) :
+    ModbusServer(bank), m_device(device), m_ignore_echo(ignore_echo) {
+    set_unit_ids(unit_ids);
+}
+
+bool ModbusRTUServer::process_next_request() {
+
+    // The length of a request is known from its header, but only t3.5 of silence delimits a frame. A response of
+    // another slave or line noise would otherwise be cut at the wrong place and merge with the next request.
+    utils::rtu::AduBuffer request;
+    std::size_t request_size = m_device.read_frame(request.data(), request.size(), request_frame_format);
+    if (request_size == 0)
+        return false;
+    const std::size_t bytes_following = m_device.flush_input_until_silent();
+
+    // address, function code and crc at least
+    if (bytes_following > 0 or request_size < consts::rtu::ADDRESS_LENGTH + 1 + consts::rtu::CRC_LENGTH or
+        not utils::Crc16Modbus().update(request.data(), request_size).frame_valid()) {
+        EVLOG_debug << "MODBUS RTU server - dropping invalid frame of " << request_size + bytes_following
+                    << " bytes";
+        return false;
+    }
+
+    const uint8_t unit_id = request[0];
+    const bool broadcast = unit_id == 0;
+    if (not broadcast and not serves_unit(unit_id))
+        return false;
+
+    utils::rtu::AduBuffer response;
+    ConstByteSpan request_pdu(request.data() + consts::rtu::ADDRESS_LENGTH,
+                              request_size - consts::rtu::ADDRESS_LENGTH - consts::rtu::CRC_LENGTH);
+    std::size_t pdu_size = process_request_pdu(
+        request_pdu, ByteSpan(response).subspan(consts::rtu::ADDRESS_LENGTH, consts::rtu::MAX_PDU));
+    if (broadcast)
+        return true;
+
+    std::size_t response_size = utils::rtu::encode_adu(response, unit_id, pdu_size);
+    m_device.write(response.data(), response_size);
+
+    if (m_ignore_echo) {
+        utils::rtu::AduBuffer echo;
+        m_device.read(echo.data(), response_size);
+    }
+    return true;
+}
+
+void ModbusRTUServer::run() {
+
+    while (not m_stop_requested)
+        process_next_request();
+    m_stop_requested = false;
+}
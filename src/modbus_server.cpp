@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <algorithm>
+
+#include <consts.hpp>
+#include <modbus/modbus_server.hpp>
+
+using namespace everest::modbus;
+
+static std::size_t exception_response(uint8_t function_code, uint8_t exception_code, ByteSpan response) {
+    response[0] = function_code | 0x80;
+    response[1] = exception_code;
+    return 2;
+}
+
+static uint16_t get_uint16(ConstByteSpan bytes, std::size_t offset) {
+    return (bytes[offset] << 8) | bytes[offset + 1];
+}
+
+void ModbusServer::set_unit_ids(const std::vector<uint8_t>& unit_ids) {
+    m_unit_ids.reset();
+    for (uint8_t unit_id : unit_ids)
+        m_unit_ids.set(unit_id);
+}
+
+std::size_t ModbusServer::process_request_pdu(ConstByteSpan request, ByteSpan response) {
+
+    using Table = RegisterBank::Table;
+
+    if (request.empty())
+        return exception_response(0, consts::ILLEGAL_FUNCTION, response);
+
+    const uint8_t function_code = request[0];
+    Table table;
+    uint16_t max_quantity;
+
+    switch (function_code) {
+    case consts::READ_COILS_FUNCTION_CODE:
+    case consts::READ_DISCRETE_INPUTS_FUNCTION_CODE:
+    case consts::READ_HOLDING_REGISTER_FUNCTION_CODE:
+    case consts::READ_INPUT_REGISTER_FUNCTION_CODE: {
+        const bool bits = function_code <= consts::READ_DISCRETE_INPUTS_FUNCTION_CODE;
+        table = function_code == consts::READ_COILS_FUNCTION_CODE            ? Table::Coils
+                : function_code == consts::READ_DISCRETE_INPUTS_FUNCTION_CODE ? Table::DiscreteInputs
+                : function_code == consts::READ_HOLDING_REGISTER_FUNCTION_CODE ? Table::HoldingRegisters
+                                                                              : Table::InputRegisters;
+        max_quantity = bits ? consts::MAX_BITS_PER_READ : consts::MAX_REGISTERS_PER_READ;
+
+        if (request.size() != 5)
+            return exception_response(function_code, consts::ILLEGAL_DATA_VALUE, response);
+        const uint16_t first = get_uint16(request, 1);
+        const uint16_t quantity = get_uint16(request, 3);
+        if (quantity == 0 or quantity > max_quantity)
+            return exception_response(function_code, consts::ILLEGAL_DATA_VALUE, response);
+        if (not m_bank.contains(table, first, quantity))
+            return exception_response(function_code, consts::ILLEGAL_DATA_ADDRESS, response);
+
+        response[0] = function_code;
+        response[1] = m_bank.read_as_bytes(table, first, quantity, response.data() + 2);
+        return 2 + response[1];
+    }
+
+    case consts::WRITE_SINGLE_COIL_FUNCTION_CODE:
+    case consts::WRITE_SINGLE_REGISTER_FUNCTION_CODE: {
+        table = function_code == consts::WRITE_SINGLE_COIL_FUNCTION_CODE ? Table::Coils : Table::HoldingRegisters;
+
+        if (request.size() != 5)
+            return exception_response(function_code, consts::ILLEGAL_DATA_VALUE, response);
+        const uint16_t address = get_uint16(request, 1);
+        uint16_t value = get_uint16(request, 3);
+        if (table == Table::Coils) {
+            if (value != 0xFF00 and value != 0x0000)
+                return exception_response(function_code, consts::ILLEGAL_DATA_VALUE, response);
+            value = value ? 1 : 0;
+        }
+        if (not m_bank.contains(table, address, 1))
+            return exception_response(function_code, consts::ILLEGAL_DATA_ADDRESS, response);
+
+        m_bank.write(table, address, value);
+        // the response echoes the request
+        std::copy(request.begin(), request.end(), response.begin());
+        return request.size();
+    }
+
+    case consts::WRITE_MULTIPLE_COILS_FUNCTION_CODE:
+    case consts::WRITE_MULTIPLE_REGISTERS_FUNCTION_CODE: {
+        const bool bits = function_code == consts::WRITE_MULTIPLE_COILS_FUNCTION_CODE;
+        table = bits ? Table::Coils : Table::HoldingRegisters;
+        max_quantity = bits ? consts::MAX_BITS_PER_WRITE : consts::MAX_REGISTERS_PER_WRITE;
+
+        if (request.size() < 6)
+            return exception_response(function_code, consts::ILLEGAL_DATA_VALUE, response);
+        const uint16_t first = get_uint16(request, 1);
+        const uint16_t quantity = get_uint16(request, 3);
+        const uint8_t byte_count = request[5];
+        const std::size_t expected_byte_count = bits ? (quantity + 7) / 8 : 2 * quantity;
+        if (quantity == 0 or quantity > max_quantity or byte_count != expected_byte_count or
+            request.size() != 6u + byte_count)
+            return exception_response(function_code, consts::ILLEGAL_DATA_VALUE, response);
+        if (not m_bank.contains(table, first, quantity))
+            return exception_response(function_code, consts::ILLEGAL_DATA_ADDRESS, response);
+
+        uint16_t values[consts::MAX_BITS_PER_WRITE];
+        for (std::size_t index = 0; index < quantity; ++index)
+            values[index] = bits ? (request[6 + index / 8] >> (index % 8)) & 1 : get_uint16(request, 6 + 2 * index);
+        m_bank.write(table, first, values, quantity);
+
+        // function code, first address and quantity
+        std::copy(request.begin(), request.begin() + 5, response.begin());
+        return 5;
+    }
+
+    default:
+        return exception_response(function_code, consts::ILLEGAL_FUNCTION, response);
+    }
+}
@@ -0,0 +1,280 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <everest/logging.hpp>
+
+#include <connection/exceptions.hpp>
+#include <consts.hpp>
+#include <modbus/modbus_server.hpp>
+
+using namespace everest::modbus;
+
+static constexpr uint64_t LISTEN_EVENT = std::numeric_limits<uint64_t>::max();
+static constexpr uint64_t WAKEUP_EVENT = std::numeric_limits<uint64_t>::max() - 1;
+
+// MBAP length field counts the unit id and the PDU
+static constexpr std::size_t MBAP_LENGTH_END = consts::tcp::MBAP_HEADER_LENGTH - 1;
+
+ModbusTCPServer::ModbusTCPServer(RegisterBank& bank, int port, const std::string& address) : ModbusServer(bank) {
+
+    using connection::exceptions::tcp::tcp_connection_error;
+
+    m_listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listen_fd == -1)
+        throw tcp_connection_error(std::string("MODBUS TCP server - socket creation failed: ") + strerror(errno));
+
+    int reuse_address = 1;
+    setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse_address, sizeof(reuse_address));
+
+    sockaddr_in server_address{};
+    server_address.sin_family = AF_INET;
+    server_address.sin_port = htons(port);
+    server_address.sin_addr.s_addr = inet_addr(address.c_str());
+    socklen_t address_length = sizeof(server_address);
+
+    if (bind(m_listen_fd, (sockaddr*)&server_address, address_length) == -1 or listen(m_listen_fd, SOMAXCONN) == -1 or
+        getsockname(m_listen_fd, (sockaddr*)&server_address, &address_length) == -1) {
+        int error_number = errno;
+        close(m_listen_fd);
+        throw tcp_connection_error("MODBUS TCP server - can not listen on " + address + ":" + std::to_string(port) +
+                                   ": " + strerror(error_number));
+    }
+    m_port = ntohs(server_address.sin_port);
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll_fd == -1 or m_wakeup_fd == -1) {
+        int error_number = errno;
+        close(m_listen_fd);
+        if (m_epoll_fd != -1)
+            close(m_epoll_fd);
+        throw tcp_connection_error(std::string("MODBUS TCP server - epoll setup failed: ") + strerror(error_number));
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTEN_EVENT;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_fd, &event);
+    event.data.u64 = WAKEUP_EVENT;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wakeup_fd, &event);
+
+    EVLOG_debug << "MODBUS TCP server - listening on " << address << ":" << m_port;
+}
+
+ModbusTCPServer::~ModbusTCPServer() {
+
+    for (auto& client : m_clients)
+        close(client.first);
+    close(m_wakeup_fd);
+    close(m_epoll_fd);
+    close(m_listen_fd);
+}
+
+std::size_t ModbusTCPServer::run_once(std::chrono::milliseconds max_wait) {
+
+    constexpr int max_events = 64;
+    epoll_event events[max_events];
+
+    int num_events = epoll_wait(m_epoll_fd, events, max_events, max_wait.count() < 0 ? 0 : max_wait.count());
+    if (num_events == -1) {
+        if (errno == EINTR)
+            return 0;
+        throw connection::exceptions::communication_error(std::string("MODBUS TCP server - epoll_wait failed: ") +
+                                                          strerror(errno));
+    }
+
+    std::size_t num_requests = 0;
+    for (int index = 0; index < num_events; ++index) {
+        const uint64_t source = events[index].data.u64;
+        if (source == LISTEN_EVENT) {
+            accept_clients();
+            continue;
+        }
+        if (source == WAKEUP_EVENT) {
+            uint64_t counter;
+            while (read(m_wakeup_fd, &counter, sizeof(counter)) > 0) {
+            }
+            continue;
+        }
+
+        auto client = m_clients.find(static_cast<int>(source));
+        if (client == m_clients.end())
+            continue;
+
+        if (events[index].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            std::size_t handled = handle_input(client->second);
+            if (handled == std::numeric_limits<std::size_t>::max()) {
+                close_client(client->first);
+                continue;
+            }
+            num_requests += handled;
+        }
+        if (not flush_output(client->second))
+            close_client(client->first);
+    }
+    return num_requests;
+}
+
+void ModbusTCPServer::run() {
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(m_stop_mutex);
+            if (m_stop_requested) {
+                m_stop_requested = false;
+                return;
+            }
+        }
+        run_once(std::chrono::milliseconds(1000));
+    }
+}
+
+void ModbusTCPServer::stop() {
+
+    {
+        std::lock_guard<std::mutex> lock(m_stop_mutex);
+        m_stop_requested = true;
+    }
+    uint64_t one = 1;
+    (void)write(m_wakeup_fd, &one, sizeof(one));
+}
+
+void ModbusTCPServer::accept_clients() {
+
+    while (true) {
+        int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EAGAIN and errno != EWOULDBLOCK and errno != EINTR)
+                EVLOG_error << "MODBUS TCP server - accept failed: " << strerror(errno);
+            return;
+        }
+
+        // responses are sent as soon as they are complete
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = static_cast<uint64_t>(fd);
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+
+        Client& client = m_clients[fd];
+        client.fd = fd;
+        client.input.reserve(consts::tcp::MAX_ADU);
+        client.output.reserve(consts::tcp::MAX_ADU);
+        EVLOG_debug << "MODBUS TCP server - accepted client, fd = " << fd;
+    }
+}
+
+// returns the number of requests answered, or size_t max if the connection has to be closed
+std::size_t ModbusTCPServer::handle_input(Client& client) {
+
+    constexpr std::size_t invalid = std::numeric_limits<std::size_t>::max();
+    std::size_t num_requests = 0;
+    uint8_t buffer[16 * 1024];
+
+    while (true) {
+        ssize_t bytes_received = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (bytes_received == 0)
+            return invalid; // closed by the client
+        if (bytes_received == -1) {
+            if (errno == EAGAIN or errno == EWOULDBLOCK)
+                return num_requests;
+            if (errno == EINTR)
+                continue;
+            return invalid;
+        }
+
+        std::vector<uint8_t>& input = client.input;
+        input.insert(input.end(), buffer, buffer + bytes_received);
+
+        std::size_t offset = 0;
+        while (input.size() - offset >= consts::tcp::MBAP_HEADER_LENGTH) {
+            const uint8_t* adu = input.data() + offset;
+            const std::size_t length = (adu[4] << 8) | adu[5];
+            const bool protocol_ok = adu[2] == 0 and adu[3] == 0;
+            if (not protocol_ok or length < 2 or MBAP_LENGTH_END + length > consts::tcp::MAX_ADU) {
+                EVLOG_error << "MODBUS TCP server - invalid MBAP header, closing connection fd = " << client.fd;
+                return invalid;
+            }
+            if (input.size() - offset < MBAP_LENGTH_END + length)
+                break;
+
+            // encode the response directly behind the pending output
+            std::vector<uint8_t>& output = client.output;
+            const std::size_t response_offset = output.size();
+            output.resize(response_offset + consts::tcp::MAX_ADU);
+            uint8_t* response = output.data() + response_offset;
+
+            ConstByteSpan request_pdu(adu + consts::tcp::MBAP_HEADER_LENGTH, length - 1);
+            ByteSpan response_pdu(response + consts::tcp::MBAP_HEADER_LENGTH, consts::tcp::MAX_PDU);
+            const uint8_t unit_id = adu[6];
+            std::size_t pdu_size;
+            if (serves_unit(unit_id)) {
+                pdu_size = process_request_pdu(request_pdu, response_pdu);
+            } else {
+                response_pdu[0] = request_pdu[0] | 0x80;
+                response_pdu[1] = consts::GATEWAY_TARGET_FAILED_TO_RESPOND;
+                pdu_size = 2;
+            }
+
+            // transaction id and protocol id are echoed
+            std::copy(adu, adu + 4, response);
+            response[4] = (pdu_size + 1) >> 8;
+            response[5] = (pdu_size + 1) & 0xff;
+            response[6] = unit_id;
+            output.resize(response_offset + consts::tcp::MBAP_HEADER_LENGTH + pdu_size);
+
+            offset += MBAP_LENGTH_END + length;
+            ++num_requests;
+        }
+        input.erase(input.begin(), input.begin() + offset);
+    }
+}
+
+// returns false if the connection has to be closed
+bool ModbusTCPServer::flush_output(Client& client) {
+
+    while (client.output_offset < client.output.size()) {
+        ssize_t bytes_sent = send(client.fd, client.output.data() + client.output_offset,
+                                  client.output.size() - client.output_offset, MSG_NOSIGNAL);
+        if (bytes_sent == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN and errno != EWOULDBLOCK)
+                return false;
+            break;
+        }
+        client.output_offset += bytes_sent;
+    }
+
+    const bool pending = client.output_offset < client.output.size();
+    if (not pending) {
+        client.output.clear();
+        client.output_offset = 0;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN | (pending ? uint32_t(EPOLLOUT) : 0u);
+    event.data.u64 = static_cast<uint64_t>(client.fd);
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, client.fd, &event);
+    return true;
+}
+
+void ModbusTCPServer::close_client(int fd) {
+
+    EVLOG_debug << "MODBUS TCP server - closing client, fd = " << fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    m_clients.erase(fd);
+}
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+#include <modbus/exceptions.hpp>
+#include <modbus/read_planner.hpp>
+
+using namespace everest::modbus;
+
+void ReadPlanner::set_max_registers_per_request(uint16_t registers) {
+    m_max_registers_per_request = std::min(std::max(registers, uint16_t(1)), consts::MAX_REGISTERS_PER_READ);
+}
+
+void ReadPlanner::add_forbidden_range(uint8_t unit_id, uint8_t function_code, uint16_t first_register_address,
+                                      uint16_t num_registers) {
+    m_forbidden_ranges.push_back(
+        {unit_id, function_code, first_register_address, uint32_t(first_register_address) + num_registers});
+}
+
+bool ReadPlanner::forbidden(uint8_t unit_id, uint8_t function_code, uint32_t first, uint32_t end) const {
+    return std::any_of(m_forbidden_ranges.begin(), m_forbidden_ranges.end(), [&](const ForbiddenRange& range) {
+        return range.unit_id == unit_id and range.function_code == function_code and
+               range.first_register_address < end and first < range.end_register_address;
+    });
+}
+
+std::vector<ReadPlanner::Request> ReadPlanner::plan(const std::vector<Read>& reads) const {
+
+    for (const Read& read : reads) {
+        // coils and discrete inputs are packed 8 per byte, scatter cuts 2 bytes per register
+        if (read.function_code != consts::READ_HOLDING_REGISTER_FUNCTION_CODE and
+            read.function_code != consts::READ_INPUT_REGISTER_FUNCTION_CODE)
+            throw std::invalid_argument("ReadPlanner - function code " + std::to_string(read.function_code) +
+                                        " does not read registers");
+        if (read.num_registers == 0 or read.num_registers > m_max_registers_per_request)
+            throw exceptions::message_size_exception("ReadPlanner - read of " + std::to_string(read.num_registers) +
+                                                     " registers, allowed are 1 to " +
+                                                     std::to_string(m_max_registers_per_request));
+    }
+
+    // reads of the same unit and function code next to each other, by address
+    std::vector<std::size_t> order(reads.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&reads](std::size_t a, std::size_t b) {
+        return std::tie(reads[a].unit_id, reads[a].function_code, reads[a].first_register_address) <
+               std::tie(reads[b].unit_id, reads[b].function_code, reads[b].first_register_address);
+    });
+
+    std::vector<Request> requests;
+    uint32_t request_end = 0; // behind the last register of requests.back()
+    for (std::size_t index : order) {
+        const Read& read = reads[index];
+        const uint32_t read_end = uint32_t(read.first_register_address) + read.num_registers;
+
+        if (not requests.empty()) {
+            Request& request = requests.back();
+            const uint32_t merged_end = std::max(request_end, read_end);
+            const bool mergeable =
+                request.unit_id == read.unit_id and request.function_code == read.function_code and
+                read.first_register_address <= request_end + m_gap_tolerance and
+                merged_end - request.first_register_address <= m_max_registers_per_request and
+                (read.first_register_address <= request_end or
+                 not forbidden(read.unit_id, read.function_code, request_end, read.first_register_address));
+            if (mergeable) {
+                request.num_registers = merged_end - request.first_register_address;
+                request.reads.push_back(index);
+                request_end = merged_end;
+                continue;
+            }
+        }
+
+        requests.push_back(
+            {read.unit_id, read.first_register_address, read.num_registers, read.function_code, {index}});
+        request_end = read_end;
+    }
+    return requests;
+}
+
+std::vector<ReadPlanner::ReadResult> ReadPlanner::scatter(const std::vector<Read>& reads,
+                                                          const std::vector<Request>& requests,
+                                                          const std::vector<DataVectorUint8>& responses,
+                                                          const std::vector<std::exception_ptr>& errors) {
+
+    std::vector<ReadResult> results(reads.size());
+    for (std::size_t request_index = 0; request_index < requests.size(); ++request_index) {
+        const Request& request = requests[request_index];
+        const DataVectorUint8& response = responses.at(request_index);
+        std::exception_ptr error = errors.at(request_index);
+
+        if (not error and response.size() != 2u * request.num_registers)
+            error = std::make_exception_ptr(exceptions::message_size_exception(
+                "ReadPlanner - expected " + std::to_string(2 * request.num_registers) + " register bytes, got " +
+                std::to_string(response.size())));
+
+        for (std::size_t read_index : request.reads) {
+            if (error) {
+                results[read_index].error = error;
+                continue;
+            }
+            const Read& read = reads[read_index];
+            auto begin = response.begin() + 2 * (read.first_register_address - request.first_register_address);
+            results[read_index].registers.assign(begin, begin + 2 * read.num_registers);
+        }
+    }
+    return results;
+}
+
+std::vector<ReadPlanner::ReadResult> ReadPlanner::read(const std::vector<Read>& reads,
+                                                       const Transceive& transceive) const {
+
+    std::vector<Request> requests = plan(reads);
+    std::vector<DataVectorUint8> responses(requests.size());
+    std::vector<std::exception_ptr> errors(requests.size());
+    for (std::size_t index = 0; index < requests.size(); ++index) {
+        try {
+            responses[index] = transceive(requests[index]);
+        } catch (const std::runtime_error&) {
+            errors[index] = std::current_exception();
+        }
+    }
+    return scatter(reads, requests, responses, errors);
+}
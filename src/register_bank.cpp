@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <stdexcept>
+#include <string>
+
+#include <modbus/register_bank.hpp>
+
+using namespace everest::modbus;
+
+static bool is_bit_table(RegisterBank::Table table) {
+    return table == RegisterBank::Table::Coils or table == RegisterBank::Table::DiscreteInputs;
+}
+
+RegisterBank::RegisterBank(std::size_t num_coils, std::size_t num_discrete_inputs, std::size_t num_holding_registers,
+                           std::size_t num_input_registers) {
+
+    const std::size_t sizes[4]{num_coils, num_discrete_inputs, num_holding_registers, num_input_registers};
+    for (std::size_t index = 0; index < 4; ++index) {
+        m_tables[index].values = std::make_unique<std::atomic<uint16_t>[]>(sizes[index]);
+        m_tables[index].size = sizes[index];
+        for (std::size_t entry = 0; entry < sizes[index]; ++entry)
+            m_tables[index].values[entry].store(0, std::memory_order_relaxed);
+    }
+}
+
+std::size_t RegisterBank::size(Table table) const {
+    return storage(table).size;
+}
+
+const RegisterBank::Storage& RegisterBank::storage(Table table) const {
+    return m_tables[static_cast<std::size_t>(table)];
+}
+
+void RegisterBank::check_range(Table table, std::size_t first, std::size_t count) const {
+    if (not contains(table, first, count))
+        throw std::out_of_range("RegisterBank: entries " + std::to_string(first) + " to " +
+                                std::to_string(first + count) + " exceed table size " + std::to_string(size(table)));
+}
+
+void RegisterBank::write(Table table, std::size_t first, const uint16_t* values, std::size_t count) {
+
+    check_range(table, first, count);
+    const Storage& target = storage(table);
+    const bool bits = is_bit_table(table);
+
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (std::size_t index = 0; index < count; ++index)
+        target.values[first + index].store(bits ? (values[index] != 0) : values[index], std::memory_order_relaxed);
+
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void RegisterBank::read(Table table, std::size_t first, uint16_t* values, std::size_t count) const {
+
+    check_range(table, first, count);
+    const Storage& source = storage(table);
+
+    read_consistent([&]() {
+        for (std::size_t index = 0; index < count; ++index)
+            values[index] = source.values[first + index].load(std::memory_order_relaxed);
+    });
+}
+
+std::size_t RegisterBank::read_as_bytes(Table table, std::size_t first, std::size_t count,
+                                        uint8_t* destination) const {
+
+    check_range(table, first, count);
+    const Storage& source = storage(table);
+
+    if (not is_bit_table(table)) {
+        read_consistent([&]() {
+            for (std::size_t index = 0; index < count; ++index) {
+                uint16_t value = source.values[first + index].load(std::memory_order_relaxed);
+                destination[2 * index] = value >> 8;
+                destination[2 * index + 1] = value & 0xff;
+            }
+        });
+        return 2 * count;
+    }
+
+    const std::size_t num_bytes = (count + 7) / 8;
+    read_consistent([&]() {
+        for (std::size_t byte = 0; byte < num_bytes; ++byte)
+            destination[byte] = 0;
+        for (std::size_t index = 0; index < count; ++index)
+            if (source.values[first + index].load(std::memory_order_relaxed))
+                destination[index / 8] |= 1 << (index % 8);
+    });
+    return num_bytes;
+}
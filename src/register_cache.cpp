@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <exception>
+
+#include <consts.hpp>
+#include <modbus/register_cache.hpp>
+
+using namespace everest::modbus;
+
+static std::atomic<uint64_t> next_cache_id{1};
+
+RegisterCache::RegisterCache(const ModbusClient& client, std::chrono::milliseconds default_ttl) :
+    m_client(client), m_id(next_cache_id++), m_snapshot(std::make_shared<const Snapshot>()),
+    m_default_ttl(default_ttl) {
+}
+
+void RegisterCache::set_ttl(uint8_t unit_id, uint16_t first_register_address, uint16_t num_registers,
+                            std::chrono::milliseconds ttl) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ttl_ranges.push_back({unit_id, first_register_address, uint32_t(first_register_address) + num_registers, ttl});
+}
+
+std::chrono::milliseconds RegisterCache::ttl_of(uint8_t unit_id, uint16_t first_register_address,
+                                                uint16_t num_registers) const {
+    const uint32_t end_register_address = uint32_t(first_register_address) + num_registers;
+    for (auto range = m_ttl_ranges.rbegin(); range != m_ttl_ranges.rend(); ++range)
+        if (range->unit_id == unit_id and range->first_register_address <= first_register_address and
+            end_register_address <= range->end_register_address)
+            return range->ttl;
+    return m_default_ttl;
+}
+
+RegisterCache::CachedRegistersPtr RegisterCache::lookup(Key key) {
+
+    // A thread switching between caches refetches the snapshot each time, which is correct but slow. The last
+    // snapshot seen stays referenced until the thread fetches another one or ends.
+    static thread_local LocalSnapshot local;
+    const uint64_t version = m_version.load(std::memory_order_acquire);
+    if (local.cache_id != m_id or local.version != version) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        local.cache_id = m_id;
+        local.version = m_version.load(std::memory_order_relaxed);
+        local.snapshot = m_snapshot;
+    }
+
+    auto entry = local.snapshot->find(key);
+    return entry == local.snapshot->end() ? nullptr : entry->second;
+}
+
+void RegisterCache::replace_snapshot(std::shared_ptr<const Snapshot> snapshot) {
+    m_snapshot = std::move(snapshot);
+    m_version.fetch_add(1, std::memory_order_release);
+}
+
+RegisterCache::CachedRegistersPtr RegisterCache::read_holding_register(uint8_t unit_id,
+                                                                       uint16_t first_register_address,
+                                                                       uint16_t num_registers_to_read) {
+
+    const Key key =
+        make_key(unit_id, consts::READ_HOLDING_REGISTER_FUNCTION_CODE, first_register_address, num_registers_to_read);
+    CachedRegistersPtr cached = lookup(key);
+    if (cached and Clock::now() < cached->expires_at)
+        return cached;
+
+    // the first caller missing the cache reads from the device, the others wait for its result
+    std::promise<CachedRegistersPtr> promise;
+    std::shared_future<CachedRegistersPtr> pending;
+    std::chrono::milliseconds ttl;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto in_flight = m_in_flight.find(key);
+        if (in_flight != m_in_flight.end()) {
+            pending = in_flight->second;
+        } else {
+            m_in_flight.emplace(key, promise.get_future().share());
+            ttl = ttl_of(unit_id, first_register_address, num_registers_to_read);
+            generation = m_generations[unit_id];
+        }
+    }
+    if (pending.valid())
+        return pending.get();
+
+    try {
+        DataVectorUint8 registers;
+        {
+            std::lock_guard<std::mutex> client_lock(m_client_mutex);
+            registers = m_client.read_holding_register(unit_id, first_register_address, num_registers_to_read);
+        }
+        const Clock::time_point now = Clock::now();
+        cached = std::make_shared<const CachedRegisters>(CachedRegisters{std::move(registers), now, now + ttl});
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // not cached if the unit was invalidated while the response was pending
+            if (ttl.count() > 0 and generation == m_generations[unit_id]) {
+                auto snapshot = std::make_shared<Snapshot>(*m_snapshot);
+                (*snapshot)[key] = cached;
+                replace_snapshot(std::move(snapshot));
+            }
+            m_in_flight.erase(key);
+        }
+        promise.set_value(cached);
+        return cached;
+
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_in_flight.erase(key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+void RegisterCache::invalidate(uint8_t unit_id) {
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generations[unit_id];
+    auto snapshot = std::make_shared<Snapshot>(*m_snapshot);
+    for (auto entry = snapshot->begin(); entry != snapshot->end();) {
+        if ((entry->first >> 40) == unit_id)
+            entry = snapshot->erase(entry);
+        else
+            ++entry;
+    }
+    replace_snapshot(std::move(snapshot));
+}
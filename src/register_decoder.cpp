@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <modbus/exceptions.hpp>
+#include <modbus/register_decoder.hpp>
+
+using namespace everest::modbus;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+namespace {
+
+// Turns the transferred bytes of a value into host order. Both steps are their own inverse and commute, so the same
+// reordering turns host order back into the transferred bytes.
+struct Reordering {
+    bool swap_bytes; // within each word
+    bool swap_words; // reverse the order of the words of each value
+};
+
+Reordering reordering(WordOrder word_order, std::size_t value_size) {
+    const bool big_endian_words = word_order == WordOrder::ABCD or word_order == WordOrder::CDAB;
+    const bool high_word_first = word_order == WordOrder::ABCD or word_order == WordOrder::BADC;
+    return {big_endian_words, high_word_first and value_size > 2};
+}
+
+// offset of the source byte that is moved to offset within the same value
+std::size_t source_offset(std::size_t offset, std::size_t value_size, Reordering steps) {
+    const std::size_t value_begin = offset - offset % value_size;
+    std::size_t word = (offset % value_size) / 2;
+    std::size_t byte = offset % 2;
+    if (steps.swap_words)
+        word = value_size / 2 - 1 - word;
+    if (steps.swap_bytes)
+        byte = 1 - byte;
+    return value_begin + 2 * word + byte;
+}
+
+void reorder(uint8_t* destination, const uint8_t* source, std::size_t num_bytes, std::size_t value_size,
+             Reordering steps) {
+
+    if (not steps.swap_bytes and not steps.swap_words) {
+        std::memcpy(destination, source, num_bytes);
+        return;
+    }
+
+    // a vector holds whole values, every value size divides 16
+    std::size_t index = 0;
+#if defined(__SSSE3__)
+    // one shuffle does both steps
+    alignas(16) uint8_t shuffle_bytes[16];
+    for (std::size_t offset = 0; offset < 16; ++offset)
+        shuffle_bytes[offset] = source_offset(offset, value_size, steps);
+    const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle_bytes));
+    for (; index + 16 <= num_bytes; index += 16) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index), _mm_shuffle_epi8(values, shuffle));
+    }
+#elif defined(__SSE2__)
+    for (; index + 16 <= num_bytes; index += 16) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index));
+        if (steps.swap_bytes)
+            values = _mm_or_si128(_mm_slli_epi16(values, 8), _mm_srli_epi16(values, 8));
+        if (steps.swap_words and value_size == 4)
+            values = _mm_shufflehi_epi16(_mm_shufflelo_epi16(values, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        else if (steps.swap_words)
+            values = _mm_shufflehi_epi16(_mm_shufflelo_epi16(values, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index), values);
+    }
+#elif defined(__ARM_NEON)
+    for (; index + 16 <= num_bytes; index += 16) {
+        uint8x16_t values = vld1q_u8(source + index);
+        if (steps.swap_bytes)
+            values = vrev16q_u8(values);
+        if (steps.swap_words and value_size == 4)
+            values = vreinterpretq_u8_u16(vrev32q_u16(vreinterpretq_u16_u8(values)));
+        else if (steps.swap_words)
+            values = vreinterpretq_u8_u16(vrev64q_u16(vreinterpretq_u16_u8(values)));
+        vst1q_u8(destination + index, values);
+    }
+#endif
+
+    for (; index < num_bytes; ++index)
+        destination[index] = source[source_offset(index, value_size, steps)];
+}
+
+template <typename T> void check_value_type() {
+    static_assert(std::is_arithmetic<T>::value and (sizeof(T) == 2 or sizeof(T) == 4 or sizeof(T) == 8),
+                  "values of 1, 2 or 4 registers only");
+}
+
+} // namespace
+
+template <typename T>
+void everest::modbus::decode_registers(Span<T> values, ConstByteSpan register_bytes, WordOrder word_order) {
+
+    check_value_type<T>();
+    const std::size_t num_bytes = values.size() * sizeof(T);
+    if (register_bytes.size() < num_bytes)
+        throw exceptions::message_size_exception("decode_registers - " + std::to_string(values.size()) +
+                                                 " values need " + std::to_string(num_bytes) + " register bytes, got " +
+                                                 std::to_string(register_bytes.size()));
+
+    reorder(reinterpret_cast<uint8_t*>(values.data()), register_bytes.data(), num_bytes, sizeof(T),
+            reordering(word_order, sizeof(T)));
+}
+
+template <typename T>
+std::vector<T> everest::modbus::decode_registers(ConstByteSpan register_bytes, WordOrder word_order) {
+
+    if (register_bytes.size() % sizeof(T) != 0)
+        throw exceptions::message_size_exception("decode_registers - " + std::to_string(register_bytes.size()) +
+                                                 " register bytes are not a multiple of " +
+                                                 std::to_string(sizeof(T)));
+    std::vector<T> values(register_bytes.size() / sizeof(T));
+    decode_registers(Span<T>(values), register_bytes, word_order);
+    return values;
+}
+
+template <typename T>
+std::size_t everest::modbus::encode_registers(ByteSpan register_bytes, Span<const T> values, WordOrder word_order) {
+
+    check_value_type<T>();
+    const std::size_t num_bytes = values.size() * sizeof(T);
+    if (register_bytes.size() < num_bytes)
+        throw exceptions::message_size_exception("encode_registers - " + std::to_string(values.size()) +
+                                                 " values need " + std::to_string(num_bytes) +
+                                                 " register bytes, buffer has " +
+                                                 std::to_string(register_bytes.size()));
+
+    reorder(register_bytes.data(), reinterpret_cast<const uint8_t*>(values.data()), num_bytes, sizeof(T),
+            reordering(word_order, sizeof(T)));
+    return num_bytes;
+}
+
+#define MODBUS_INSTANTIATE_REGISTER_CODEC(T)                                                                           \
+    template void everest::modbus::decode_registers<T>(Span<T>, ConstByteSpan, WordOrder);                             \
+    template std::vector<T> everest::modbus::decode_registers<T>(ConstByteSpan, WordOrder);                            \
+    template std::size_t everest::modbus::encode_registers<T>(ByteSpan, Span<const T>, WordOrder);
+
+MODBUS_INSTANTIATE_REGISTER_CODEC(int16_t)
+MODBUS_INSTANTIATE_REGISTER_CODEC(uint16_t)
+MODBUS_INSTANTIATE_REGISTER_CODEC(int32_t)
+MODBUS_INSTANTIATE_REGISTER_CODEC(uint32_t)
+MODBUS_INSTANTIATE_REGISTER_CODEC(float)
+MODBUS_INSTANTIATE_REGISTER_CODEC(int64_t)
+MODBUS_INSTANTIATE_REGISTER_CODEC(uint64_t)
+MODBUS_INSTANTIATE_REGISTER_CODEC(double)
+
+#undef MODBUS_INSTANTIATE_REGISTER_CODEC
+
+#else
+
+static_assert(false, "implementation currently done for little endian only");
+
+#endif
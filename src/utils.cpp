@@ -2,11 +2,21 @@
 // Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
 
 #include <algorithm>
+#include <array>
+#include <cstring>
 #include <iostream>
-#include <limits>
-#include <random>
 #include <stdio.h>
-#include <stdlib.h>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include <modbus/exceptions.hpp>
 #include <modbus/utils.hpp>
@@ -16,15 +26,15 @@
 namespace everest {
 namespace modbus {
 
-std::vector<uint8_t> utils::ip::make_mbap_header(uint16_t message_length, uint8_t unit_id) {
-
-    // Header buffer
-    std::vector<uint8_t> mbap_header(consts::tcp::MBAP_HEADER_LENGTH);
+static void check_buffer_size(ByteSpan buffer, std::size_t required_size, const std::string& function) {
+    if (buffer.size() < required_size)
+        throw exceptions::message_size_exception(function + " buffer of " + std::to_string(buffer.size()) +
+                                                 " bytes is too small for " + std::to_string(required_size) +
+                                                 " bytes.");
+}
 
-    // Generating random 2 byte transaction ID
-    // uint16_t transac tion_id = 1;
-    srand(time(0));
-    uint16_t transaction_id = rand() % std::numeric_limits<uint16_t>::max();
+static void write_mbap_header(uint8_t* mbap_header, uint16_t transaction_id, uint16_t message_length,
+                              uint8_t unit_id) {
 
     // Adding transaction ID bytes
     mbap_header[0] = (transaction_id >> 8) & 0xFF;
@@ -40,27 +50,132 @@ std::vector<uint8_t> utils::ip::make_mbap_header(uint16_t message_length, uint8_
 
     // Adding unit/slave ID
     mbap_header[6] = unit_id;
+}
 
+std::vector<uint8_t> utils::ip::make_mbap_header(uint16_t message_length, uint8_t unit_id) {
+    return make_mbap_header(0, message_length, unit_id);
+}
+
+std::vector<uint8_t> utils::ip::make_mbap_header(uint16_t transaction_id, uint16_t message_length, uint8_t unit_id) {
+
+    // Header buffer
+    std::vector<uint8_t> mbap_header(consts::tcp::MBAP_HEADER_LENGTH);
+    write_mbap_header(mbap_header.data(), transaction_id, message_length, unit_id);
     return mbap_header;
 }
 
+uint16_t utils::ip::get_transaction_id(ConstByteSpan message) {
+    return (message.at(0) << 8) | message.at(1);
+}
+
+std::size_t utils::ip::encode_adu(ByteSpan buffer, uint16_t transaction_id, uint8_t unit_id, std::size_t pdu_size) {
+
+    const std::size_t adu_size = consts::tcp::MBAP_HEADER_LENGTH + pdu_size;
+    check_buffer_size(buffer, adu_size, __PRETTY_FUNCTION__);
+    if (adu_size > consts::tcp::MAX_ADU)
+        throw exceptions::message_size_exception(std::string(__PRETTY_FUNCTION__) + " ADU size " +
+                                                 std::to_string(adu_size) + " exceeds the maximum of " +
+                                                 std::to_string(consts::tcp::MAX_ADU) + " bytes.");
+
+    // the length field counts the unit id and the PDU
+    write_mbap_header(buffer.data(), transaction_id, pdu_size + 1, unit_id);
+    return adu_size;
+}
+
+std::size_t utils::rtu::encode_adu(ByteSpan buffer, uint8_t unit_id, std::size_t pdu_size) {
+
+    const std::size_t adu_size = consts::rtu::ADDRESS_LENGTH + pdu_size + consts::rtu::CRC_LENGTH;
+    check_buffer_size(buffer, adu_size, __PRETTY_FUNCTION__);
+    if (adu_size > consts::rtu::MAX_ADU)
+        throw exceptions::message_size_exception(std::string(__PRETTY_FUNCTION__) + " ADU size " +
+                                                 std::to_string(adu_size) + " exceeds the maximum of " +
+                                                 std::to_string(consts::rtu::MAX_ADU) + " bytes.");
+
+    buffer[0] = unit_id;
+
+    // crc16 is sent high byte first
+    CRCResultType crc = calcCRC_16_ANSI(buffer.data(), consts::rtu::ADDRESS_LENGTH + pdu_size);
+    buffer[adu_size - 2] = (crc >> 8) & 0xFF;
+    buffer[adu_size - 1] = crc & 0xFF;
+
+    return adu_size;
+}
+
+std::size_t utils::ip::frame_length(const uint8_t* header) {
+
+    // the length field counts the unit id, function code and data bytes
+    const std::size_t number_of_following_bytes = (header[4] << 8) | header[5];
+    if (number_of_following_bytes < 2 or number_of_following_bytes > consts::tcp::MAX_ADU - FRAME_HEADER_LENGTH)
+        return 0;
+    return FRAME_HEADER_LENGTH + number_of_following_bytes;
+}
+
+std::size_t utils::rtu::response_frame_length(const uint8_t* header) {
+
+    const uint8_t function_code = header[1];
+    if (function_code & 0x80) // exception response: unit id, function code, exception code, crc
+        return consts::rtu::ADDRESS_LENGTH + 2 + consts::rtu::CRC_LENGTH;
+
+    switch (function_code) {
+    case consts::READ_COILS_FUNCTION_CODE:
+    case consts::READ_DISCRETE_INPUTS_FUNCTION_CODE:
+    case consts::READ_HOLDING_REGISTER_FUNCTION_CODE:
+    case consts::READ_INPUT_REGISTER_FUNCTION_CODE:
+        return RESPONSE_HEADER_LENGTH + header[2] + consts::rtu::CRC_LENGTH;
+    case consts::WRITE_SINGLE_COIL_FUNCTION_CODE:
+    case consts::WRITE_SINGLE_REGISTER_FUNCTION_CODE:
+    case consts::WRITE_MULTIPLE_COILS_FUNCTION_CODE:
+    case consts::WRITE_MULTIPLE_REGISTERS_FUNCTION_CODE:
+        return consts::rtu::ADDRESS_LENGTH + 5 + consts::rtu::CRC_LENGTH;
+    default:
+        return 0;
+    }
+}
+
+std::size_t utils::rtu::request_frame_length(const uint8_t* header) {
+
+    switch (header[1]) {
+    case consts::READ_COILS_FUNCTION_CODE:
+    case consts::READ_DISCRETE_INPUTS_FUNCTION_CODE:
+    case consts::READ_HOLDING_REGISTER_FUNCTION_CODE:
+    case consts::READ_INPUT_REGISTER_FUNCTION_CODE:
+    case consts::WRITE_SINGLE_COIL_FUNCTION_CODE:
+    case consts::WRITE_SINGLE_REGISTER_FUNCTION_CODE:
+        return consts::rtu::ADDRESS_LENGTH + 5 + consts::rtu::CRC_LENGTH;
+    case consts::WRITE_MULTIPLE_COILS_FUNCTION_CODE:
+    case consts::WRITE_MULTIPLE_REGISTERS_FUNCTION_CODE:
+        return REQUEST_HEADER_LENGTH + header[6] + consts::rtu::CRC_LENGTH;
+    default:
+        return 0;
+    }
+}
+
 std::vector<uint8_t> utils::build_read_command_message_body(std::uint8_t function_code, uint16_t first_register_address,
                                                             uint16_t num_registers_to_read) {
 
     std::vector<uint8_t> message_body(consts::READ_REGISTER_COMMAND_LENGTH - 1);
+    encode_read_command_message_body(message_body, function_code, first_register_address, num_registers_to_read);
+    return message_body;
+}
+
+std::size_t utils::encode_read_command_message_body(ByteSpan buffer, std::uint8_t function_code,
+                                                    uint16_t first_register_address, uint16_t num_registers_to_read) {
+
+    const std::size_t message_body_size = consts::READ_REGISTER_COMMAND_LENGTH - 1;
+    check_buffer_size(buffer, message_body_size, __PRETTY_FUNCTION__);
 
     // Adding read function code
-    message_body[0] = function_code;
+    buffer[0] = function_code;
 
     // Adding first register data address
-    message_body[1] = (first_register_address >> 8) & 0xFF;
-    message_body[2] = first_register_address & 0xFF;
+    buffer[1] = (first_register_address >> 8) & 0xFF;
+    buffer[2] = first_register_address & 0xFF;
 
     // Adding requested register number
-    message_body[3] = (num_registers_to_read >> 8) & 0xFF;
-    message_body[4] = num_registers_to_read & 0xFF;
+    buffer[3] = (num_registers_to_read >> 8) & 0xFF;
+    buffer[4] = num_registers_to_read & 0xFF;
 
-    return message_body;
+    return message_body_size;
 }
 
 std::vector<uint8_t> utils::build_read_holding_register_message_body(uint16_t first_register_address,
@@ -79,32 +194,61 @@ std::vector<uint8_t>
 utils::build_write_multiple_register_body(uint16_t first_register_address, uint16_t num_registers_to_write,
                                           const ::everest::modbus::ModbusDataContainerUint16& payload) {
 
-    std::vector<uint8_t> message_body;
-    message_body.reserve(1 + // function code
-                         2 + // starting address
-                         2 + // quantity of registers
-                         payload.size());
+    std::vector<uint8_t> message_body(1 + // function code
+                                      2 + // starting address
+                                      2 + // quantity of registers
+                                      1 + // byte count
+                                      payload.size() * 2);
+    encode_write_multiple_register_body(message_body, first_register_address, num_registers_to_write, payload);
+    return message_body;
+}
+
+std::size_t utils::encode_write_multiple_register_body(ByteSpan buffer, uint16_t first_register_address,
+                                                       uint16_t num_registers_to_write,
+                                                       const ::everest::modbus::ModbusDataContainerUint16& payload) {
+
+    const std::size_t header_size = 6;
+    check_buffer_size(buffer, header_size + payload.size() * 2, __PRETTY_FUNCTION__);
 
-    message_body.push_back(0x10); // function code
+    buffer[0] = 0x10; // function code
 
     // first register address
-    message_body.push_back((first_register_address >> 8) & 0xff); // hibyte
-    message_body.push_back(first_register_address & 0xff);        // lowbyte
+    buffer[1] = (first_register_address >> 8) & 0xff; // hibyte
+    buffer[2] = first_register_address & 0xff;        // lowbyte
 
     // number of registers to write
-    message_body.push_back((num_registers_to_write >> 8) & 0xff); // hibyte
-    message_body.push_back(num_registers_to_write & 0xff);        // lowbyte
+    buffer[3] = (num_registers_to_write >> 8) & 0xff; // hibyte
+    buffer[4] = num_registers_to_write & 0xff;        // lowbyte
 
     // byte count: for now only 16 bit register, so bytecount is num_registers_to_write * 2
-    message_body.push_back(num_registers_to_write * 2);
-    std::vector<uint8_t> payload_big_endian = payload.get_payload_as_bigendian();
-    std::copy(payload_big_endian.cbegin(), payload_big_endian.cend(), std::back_inserter(message_body));
+    buffer[5] = num_registers_to_write * 2;
 
-    return message_body;
+    return header_size + payload.copy_payload_as_bigendian(buffer.subspan(header_size));
+}
+
+std::size_t utils::encode_write_multiple_register_body(ByteSpan buffer, uint16_t first_register_address,
+                                                       uint16_t num_registers_to_write, ConstByteSpan register_bytes) {
+
+    const std::size_t header_size = 6;
+    check_buffer_size(buffer, header_size + register_bytes.size(), __PRETTY_FUNCTION__);
+
+    buffer[0] = consts::WRITE_MULTIPLE_REGISTERS_FUNCTION_CODE;
+    buffer[1] = (first_register_address >> 8) & 0xff;
+    buffer[2] = first_register_address & 0xff;
+    buffer[3] = (num_registers_to_write >> 8) & 0xff;
+    buffer[4] = num_registers_to_write & 0xff;
+    buffer[5] = register_bytes.size();
+
+    std::copy(register_bytes.begin(), register_bytes.end(), buffer.begin() + header_size);
+    return header_size + register_bytes.size();
 }
 
-uint16_t utils::ip::check_mbap_header(const std::vector<uint8_t>& sent_message,
-                                      const std::vector<uint8_t>& received_message) {
+uint16_t utils::ip::check_mbap_header(ConstByteSpan sent_message, ConstByteSpan received_message) {
+
+    // MBAP header and function code
+    if (received_message.size() < consts::tcp::MBAP_HEADER_LENGTH + 1u)
+        throw exceptions::empty_response("MODBUS TCP - Response of " + std::to_string(received_message.size()) +
+                                         " bytes is too short, maybe timeout on reading device.");
 
     // Validating echoed transaction ID
     bool transaction_id_match = (sent_message[0] == received_message[0] && sent_message[1] == received_message[1]);
@@ -122,6 +266,13 @@ uint16_t utils::ip::check_mbap_header(const std::vector<uint8_t>& sent_message,
         throw exceptions::unmatched_response("MODBUS TCP - Sent and received unit ID's do not match."
                                              "");
 
+    // Exception responses echo the function code with the highest bit set, followed by the exception code
+    bool exception_response = (received_message[7] == (sent_message[7] | 0x80));
+    if (exception_response && received_message.size() > 8)
+        throw exceptions::modbus_exception("MODBUS TCP - Exception response received, exception code " +
+                                               std::to_string(received_message[8]) + ".",
+                                           received_message[8]);
+
     // Validating echoed function code
     bool function_code_match = (sent_message[7] == received_message[7]);
     if (!function_code_match)
@@ -146,10 +297,16 @@ std::vector<uint8_t> utils::extract_register_bytes_from_response(const std::vect
 }
 
 std::vector<uint8_t> utils::extract_registers_bytes_from_response_body(const std::vector<uint8_t>& response_body) {
+    ConstByteSpan register_bytes = view_registers_bytes_from_response_body(response_body);
+    return std::vector<uint8_t>(register_bytes.begin(), register_bytes.end());
+}
+
+ConstByteSpan utils::view_registers_bytes_from_response_body(ConstByteSpan response_body) {
     uint8_t num_register_bytes = response_body.at(2);
-    std::vector<uint8_t> register_bytes =
-        std::vector<uint8_t>(response_body.begin() + 3, response_body.begin() + 3 + num_register_bytes);
-    return register_bytes;
+    if (response_body.size() < 3u + num_register_bytes)
+        throw exceptions::unmatched_response("Byte count " + std::to_string(num_register_bytes) +
+                                             " exceeds the size of the response.");
+    return response_body.subspan(3, num_register_bytes);
 }
 
 void utils::print_message_hex(const std::vector<uint8_t>& message) {
@@ -166,58 +323,131 @@ void utils::print_message_first_N_bytes(unsigned char* message, int N) {
     printf("\n");
 }
 
+namespace {
+
+// swaps the two bytes of each of num_words 16 bit words from source into destination. The vector loops cover the
+// bulk of a 125 register response, the scalar loop the rest.
+void swap_bytes_16(uint8_t* destination, const uint8_t* source, std::size_t num_words) {
+
+    const std::size_t num_bytes = 2 * num_words;
+    std::size_t index = 0;
+
+#if defined(__AVX2__)
+    const __m256i shuffle_256 = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5,
+                                                 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    for (; index + 32 <= num_bytes; index += 32) {
+        __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + index));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + index), _mm256_shuffle_epi8(words, shuffle_256));
+    }
+#endif
+#if defined(__SSSE3__)
+    const __m128i shuffle = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    for (; index + 16 <= num_bytes; index += 16) {
+        __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index), _mm_shuffle_epi8(words, shuffle));
+    }
+#elif defined(__SSE2__)
+    for (; index + 16 <= num_bytes; index += 16) {
+        __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + index));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + index),
+                         _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8)));
+    }
+#elif defined(__ARM_NEON)
+    for (; index + 16 <= num_bytes; index += 16)
+        vst1q_u8(destination + index, vrev16q_u8(vld1q_u8(source + index)));
+#endif
+
+    for (; index < num_bytes; index += 2) {
+        destination[index] = source[index + 1];
+        destination[index + 1] = source[index];
+    }
+}
+
+// CRC-16/MODBUS in its reflected form: polynomial 0x8005 bit reversed, processed lsb first.
+constexpr uint16_t CRC16_REFLECTED_POLYNOMIAL = 0xA001;
+constexpr std::size_t CRC16_SLICES = 8;
+
+using CRC16Tables = std::array<std::array<uint16_t, 256>, CRC16_SLICES>;
+
+// tables[0] is the classic byte table, tables[n] holds the crc of a byte followed by n zero bytes. This allows to
+// process 8 bytes per step with independent table lookups (slice-by-8).
+constexpr CRC16Tables make_crc16_tables() {
+    CRC16Tables tables{};
+    for (unsigned byte = 0; byte < 256; ++byte) {
+        uint16_t crc = byte;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc & 1) ? (crc >> 1) ^ CRC16_REFLECTED_POLYNOMIAL : crc >> 1;
+        tables[0][byte] = crc;
+    }
+    for (std::size_t slice = 1; slice < CRC16_SLICES; ++slice)
+        for (unsigned byte = 0; byte < 256; ++byte)
+            tables[slice][byte] = (tables[slice - 1][byte] >> 8) ^ tables[0][tables[slice - 1][byte] & 0xff];
+    return tables;
+}
+
+constexpr CRC16Tables crc16_tables = make_crc16_tables();
+
+// crc register in transmission order: low byte is sent first
+uint16_t crc16_update(uint16_t crc, const utils::PayloadType* payload, std::size_t payload_length) {
+
+    while (payload_length >= CRC16_SLICES) {
+        crc ^= payload[0] | (payload[1] << 8);
+        crc = crc16_tables[7][crc & 0xff] ^ crc16_tables[6][crc >> 8] ^ crc16_tables[5][payload[2]] ^
+              crc16_tables[4][payload[3]] ^ crc16_tables[3][payload[4]] ^ crc16_tables[2][payload[5]] ^
+              crc16_tables[1][payload[6]] ^ crc16_tables[0][payload[7]];
+        payload += CRC16_SLICES;
+        payload_length -= CRC16_SLICES;
+    }
+
+    while (payload_length--)
+        crc = (crc >> 8) ^ crc16_tables[0][(crc ^ *payload++) & 0xff];
+
+    return crc;
+}
+
+} // namespace
+
+void utils::registers_to_big_endian(uint8_t* register_bytes, const uint16_t* values, std::size_t num_registers) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    swap_bytes_16(register_bytes, reinterpret_cast<const uint8_t*>(values), num_registers);
+#else
+    std::memcpy(register_bytes, values, 2 * num_registers);
+#endif
+}
+
+void utils::registers_from_big_endian(uint16_t* values, const uint8_t* register_bytes, std::size_t num_registers) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    swap_bytes_16(reinterpret_cast<uint8_t*>(values), register_bytes, num_registers);
+#else
+    std::memcpy(values, register_bytes, 2 * num_registers);
+#endif
+}
+
+DataVectorUint16 utils::registers_from_big_endian(ConstByteSpan register_bytes) {
+
+    if (register_bytes.size() % 2 != 0)
+        throw exceptions::message_size_exception("registers_from_big_endian - odd number of register bytes: " +
+                                                 std::to_string(register_bytes.size()));
+    DataVectorUint16 values(register_bytes.size() / 2);
+    registers_from_big_endian(values.data(), register_bytes.data(), values.size());
+    return values;
+}
+
 utils::CRCResultType utils::calcCRC_16_ANSI(const utils::PayloadType* payload, std::size_t payload_length) {
 
     // https://en.wikipedia.org/wiki/Cyclic_redundancy_check#Polynomial_representations_of_cyclic_redundancy_checks
-    // implementation stolen from: https://modbus.org/docs/PI_MBUS_300.pdf
-
-    // High-Order Byte Table
-    /* Table of CRC values for high–order byte */
-    const utils::PayloadType auchCRCHi[] = {
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-        0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-        0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0,
-        0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-        0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1,
-        0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-        0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1,
-        0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40};
-
-    /* Table of CRC values for low–order byte */
-    const utils::PayloadType auchCRCLo[] = {
-        0x00, 0xC0, 0xC1, 0x01, 0xC3, 0x03, 0x02, 0xC2, 0xC6, 0x06, 0x07, 0xC7, 0x05, 0xC5, 0xC4, 0x04, 0xCC, 0x0C,
-        0x0D, 0xCD, 0x0F, 0xCF, 0xCE, 0x0E, 0x0A, 0xCA, 0xCB, 0x0B, 0xC9, 0x09, 0x08, 0xC8, 0xD8, 0x18, 0x19, 0xD9,
-        0x1B, 0xDB, 0xDA, 0x1A, 0x1E, 0xDE, 0xDF, 0x1F, 0xDD, 0x1D, 0x1C, 0xDC, 0x14, 0xD4, 0xD5, 0x15, 0xD7, 0x17,
-        0x16, 0xD6, 0xD2, 0x12, 0x13, 0xD3, 0x11, 0xD1, 0xD0, 0x10, 0xF0, 0x30, 0x31, 0xF1, 0x33, 0xF3, 0xF2, 0x32,
-        0x36, 0xF6, 0xF7, 0x37, 0xF5, 0x35, 0x34, 0xF4, 0x3C, 0xFC, 0xFD, 0x3D, 0xFF, 0x3F, 0x3E, 0xFE, 0xFA, 0x3A,
-        0x3B, 0xFB, 0x39, 0xF9, 0xF8, 0x38, 0x28, 0xE8, 0xE9, 0x29, 0xEB, 0x2B, 0x2A, 0xEA, 0xEE, 0x2E, 0x2F, 0xEF,
-        0x2D, 0xED, 0xEC, 0x2C, 0xE4, 0x24, 0x25, 0xE5, 0x27, 0xE7, 0xE6, 0x26, 0x22, 0xE2, 0xE3, 0x23, 0xE1, 0x21,
-        0x20, 0xE0, 0xA0, 0x60, 0x61, 0xA1, 0x63, 0xA3, 0xA2, 0x62, 0x66, 0xA6, 0xA7, 0x67, 0xA5, 0x65, 0x64, 0xA4,
-        0x6C, 0xAC, 0xAD, 0x6D, 0xAF, 0x6F, 0x6E, 0xAE, 0xAA, 0x6A, 0x6B, 0xAB, 0x69, 0xA9, 0xA8, 0x68, 0x78, 0xB8,
-        0xB9, 0x79, 0xBB, 0x7B, 0x7A, 0xBA, 0xBE, 0x7E, 0x7F, 0xBF, 0x7D, 0xBD, 0xBC, 0x7C, 0xB4, 0x74, 0x75, 0xB5,
-        0x77, 0xB7, 0xB6, 0x76, 0x72, 0xB2, 0xB3, 0x73, 0xB1, 0x71, 0x70, 0xB0, 0x50, 0x90, 0x91, 0x51, 0x93, 0x53,
-        0x52, 0x92, 0x96, 0x56, 0x57, 0x97, 0x55, 0x95, 0x94, 0x54, 0x9C, 0x5C, 0x5D, 0x9D, 0x5F, 0x9F, 0x9E, 0x5E,
-        0x5A, 0x9A, 0x9B, 0x5B, 0x99, 0x59, 0x58, 0x98, 0x88, 0x48, 0x49, 0x89, 0x4B, 0x8B, 0x8A, 0x4A, 0x4E, 0x8E,
-        0x8F, 0x4F, 0x8D, 0x4D, 0x4C, 0x8C, 0x44, 0x84, 0x85, 0x45, 0x87, 0x47, 0x46, 0x86, 0x82, 0x42, 0x43, 0x83,
-        0x41, 0x81, 0x80, 0x40};
-
-    utils::PayloadType uchCRCHi = 0xff;
-    utils::PayloadType uchCRCLo = 0xff;
-
-    while (payload_length--) {
-        std::size_t uIndex = uchCRCHi ^ *payload++;
-        uchCRCHi = uchCRCLo ^ auchCRCHi[uIndex];
-        uchCRCLo = auchCRCLo[uIndex];
-    }
+    return Crc16Modbus().update(payload, payload_length).value();
+}
+
+utils::Crc16Modbus& utils::Crc16Modbus::update(const PayloadType* payload, std::size_t payload_length) {
+    m_crc = crc16_update(m_crc, payload, payload_length);
+    return *this;
+}
 
-    return (uchCRCHi << 8 | uchCRCLo);
+utils::CRCResultType utils::Crc16Modbus::value() const {
+    // Same results as the two table implementation from https://modbus.org/docs/PI_MBUS_300.pdf: the byte sent first
+    // is returned as the high byte.
+    return (m_crc << 8 | m_crc >> 8) & 0xffff;
 }
 } // namespace modbus
 } // namespace everest
@@ -8,9 +8,19 @@
 #include <connection/serial_connection_helper.hpp>
 #include <consts.hpp>
 #include <modbus/exceptions.hpp>
+#include <modbus/modbus_rtu_bus_scheduler.hpp>
+#include <modbus/read_planner.hpp>
+#include <modbus/register_decoder.hpp>
+#include <modbus/register_map.hpp>
 #include <modbus/utils.hpp>
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
 
 using namespace everest::modbus::utils;
 
@@ -90,6 +100,54 @@ TEST(RTUTests, test_crc16) {
     }
 }
 
+TEST(RTUTests, test_crc16_all_lengths) {
+
+    // compare against a bitwise implementation, covering the 8 byte steps as well as the remaining bytes
+
+    auto crc16_bitwise = [](const PayloadType* payload, std::size_t payload_length) {
+        uint16_t crc = 0xffff;
+        for (std::size_t index = 0; index < payload_length; ++index) {
+            crc ^= payload[index];
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+        // the byte sent first is returned as high byte
+        return static_cast<CRCResultType>((crc << 8 | crc >> 8) & 0xffff);
+    };
+
+    std::vector<PayloadType> payload(everest::modbus::consts::rtu::MAX_ADU);
+    uint32_t state = 0x12345678;
+    for (auto& byte : payload) {
+        state = state * 1664525 + 1013904223;
+        byte = state >> 24;
+    }
+
+    for (std::size_t length = 0; length <= payload.size(); ++length)
+        ASSERT_EQ(calcCRC_16_ANSI(payload.data(), length), crc16_bitwise(payload.data(), length)) << length;
+}
+
+TEST(RTUTests, test_crc16_incremental) {
+
+    // sunspec get_common request including its crc, see test_crc16
+    const PayloadType frame[]{0x2A, 0x03, 0x9C, 0x9C, 0x00, 0x69, 0x6D, 0x81};
+
+    Crc16Modbus crc;
+    for (std::size_t index = 0; index < sizeof(frame); ++index) {
+        // the frame is complete exactly when its last byte arrived
+        EXPECT_FALSE(crc.frame_valid()) << index;
+        if (index == sizeof(frame) - 2) {
+            EXPECT_EQ(crc.value(), 0x6d81);
+        }
+        crc.update(frame[index]);
+    }
+    EXPECT_TRUE(crc.frame_valid());
+
+    // chunks give the same result as single bytes
+    crc.reset();
+    crc.update(frame, 3).update(frame + 3, 3);
+    EXPECT_EQ(crc.value(), calcCRC_16_ANSI(frame, 6));
+}
+
 TEST(RTUTests, test_ModbusDataContainerUint16) {
 
     using namespace everest::modbus;
@@ -116,6 +174,156 @@ TEST(RTUTests, test_ModbusDataContainerUint16) {
     }
 }
 
+TEST(RTUTests, test_register_byte_order) {
+
+    using namespace everest::modbus;
+
+    // all lengths around the vector widths, so both the vector and the scalar loops are covered
+    for (std::size_t num_registers = 0; num_registers <= 70; ++num_registers) {
+        DataVectorUint16 values(num_registers);
+        DataVectorUint8 expected;
+        for (std::size_t index = 0; index < num_registers; ++index) {
+            values[index] = 0x0102 * index + 0x8001;
+            expected.push_back(values[index] >> 8);
+            expected.push_back(values[index] & 0xff);
+        }
+
+        // an offset of one byte makes the accesses unaligned
+        DataVectorUint8 register_bytes(2 * num_registers + 1);
+        utils::registers_to_big_endian(register_bytes.data() + 1, values.data(), num_registers);
+        ASSERT_EQ(DataVectorUint8(register_bytes.begin() + 1, register_bytes.end()), expected) << num_registers;
+        ASSERT_EQ(utils::registers_from_big_endian(ConstByteSpan(register_bytes).subspan(1)), values) << num_registers;
+        ASSERT_EQ(ModbusDataContainerUint16(ByteOrder::LittleEndian, values).get_payload_as_bigendian(), expected);
+    }
+
+    DataVectorUint8 odd{0x01, 0x02, 0x03};
+    EXPECT_THROW(utils::registers_from_big_endian(odd), exceptions::message_size_exception);
+}
+
+TEST(RTUTests, test_register_decoder_word_orders) {
+
+    using namespace everest::modbus;
+
+    // 123.456f is 0x42f6e979
+    const DataVectorUint8 abcd{0x42, 0xf6, 0xe9, 0x79};
+    EXPECT_EQ(decode_registers<float>(abcd, WordOrder::ABCD), std::vector<float>{123.456f});
+    EXPECT_EQ(decode_registers<float>(DataVectorUint8{0xe9, 0x79, 0x42, 0xf6}, WordOrder::CDAB),
+              std::vector<float>{123.456f});
+    EXPECT_EQ(decode_registers<float>(DataVectorUint8{0xf6, 0x42, 0x79, 0xe9}, WordOrder::BADC),
+              std::vector<float>{123.456f});
+    EXPECT_EQ(decode_registers<float>(DataVectorUint8{0x79, 0xe9, 0xf6, 0x42}, WordOrder::DCBA),
+              std::vector<float>{123.456f});
+    EXPECT_EQ(decode_registers<int16_t>(DataVectorUint8{0xff, 0xfe, 0x01, 0x00}), (std::vector<int16_t>{-2, 256}));
+
+    // enough values for the vector loops and a scalar rest, compared against the transferred byte patterns
+    std::vector<int64_t> values;
+    for (int64_t index = 0; index < 9; ++index)
+        values.push_back(0x0102030405060708 * (index + 1) - 3 * index);
+    const std::map<WordOrder, std::array<int, 8>> significance{{WordOrder::ABCD, {7, 6, 5, 4, 3, 2, 1, 0}},
+                                                               {WordOrder::CDAB, {1, 0, 3, 2, 5, 4, 7, 6}},
+                                                               {WordOrder::BADC, {6, 7, 4, 5, 2, 3, 0, 1}},
+                                                               {WordOrder::DCBA, {0, 1, 2, 3, 4, 5, 6, 7}}};
+    for (const auto& order : significance) {
+        DataVectorUint8 expected;
+        for (int64_t value : values)
+            for (int byte : order.second)
+                expected.push_back(static_cast<uint64_t>(value) >> (8 * byte));
+
+        DataVectorUint8 register_bytes(expected.size());
+        EXPECT_EQ(encode_registers<int64_t>(register_bytes, values, order.first), expected.size());
+        EXPECT_EQ(register_bytes, expected);
+        EXPECT_EQ(decode_registers<int64_t>(expected, order.first), values);
+
+        // the 32 bit halves of the same bytes
+        std::vector<uint32_t> halves = decode_registers<uint32_t>(expected, order.first);
+        ASSERT_EQ(halves.size(), 2 * values.size());
+        const bool high_word_first = order.first == WordOrder::ABCD or order.first == WordOrder::BADC;
+        EXPECT_EQ(halves[high_word_first ? 1 : 0], static_cast<uint32_t>(values[0]));
+    }
+
+    std::vector<double> doubles(2);
+    EXPECT_THROW(decode_registers(Span<double>(doubles), DataVectorUint8(15)), exceptions::message_size_exception);
+    EXPECT_THROW(decode_registers<uint32_t>(DataVectorUint8(6)), exceptions::message_size_exception);
+}
+
+namespace meter {
+
+using namespace everest::modbus;
+
+constexpr RegisterDefinition registers[]{
+    {"energy_import", 0x0100, RegisterType::UInt64, WordOrder::CDAB, 0.001},
+    {"voltage_l1", 0x0000, RegisterType::Float32},
+    {"current_l1", 0x0006, RegisterType::Int32, WordOrder::ABCD, 0.01},
+    {"frequency", 0x0003, RegisterType::UInt16, WordOrder::ABCD, 0.1},
+    {"temperature", 0x0010, RegisterType::Int16, WordOrder::ABCD, 1.0, consts::READ_INPUT_REGISTER_FUNCTION_CODE},
+};
+
+// the unrequested registers 0x0002, 0x0004 and 0x0005 are read along, the energy is too far away
+constexpr RegisterMap map(registers, 2);
+static_assert(map.num_requests() == 3);
+static_assert(map.request(0).first_register_address == 0x0000 and map.request(0).num_registers == 8);
+static_assert(map.request(1).first_register_address == 0x0100 and map.request(1).num_registers == 4);
+static_assert(map.request(2).function_code == consts::READ_INPUT_REGISTER_FUNCTION_CODE);
+static_assert(map.index_of("current_l1") == 2);
+
+// the device refuses to read 0x0005, so the gap in front of current_l1 is not read
+constexpr ForbiddenRegisters forbidden[]{{0x0005, 1}, {0x0002, 1, consts::READ_INPUT_REGISTER_FUNCTION_CODE}};
+constexpr RegisterMap map_with_gaps(registers, forbidden, 2);
+static_assert(map_with_gaps.num_requests() == 4);
+static_assert(map_with_gaps.request(0).first_register_address == 0x0000 and
+              map_with_gaps.request(0).num_registers == 4);
+static_assert(map_with_gaps.request(1).first_register_address == 0x0006);
+
+} // namespace meter
+
+TEST(RTUTests, test_register_map) {
+
+    using namespace everest::modbus;
+
+    std::map<uint16_t, DataVectorUint8> device{
+        {0x0000, {0x42, 0xf6, 0xe9, 0x79, 0xaa, 0xaa, 0x01, 0xf4, 0xbb, 0xbb, 0xbb, 0xbb, 0xff, 0xff, 0xfc, 0x18}},
+        {0x0100, {0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00}},
+        {0x0010, {0xff, 0xf6}}};
+
+    std::vector<uint8_t> function_codes;
+    std::array<double, meter::map.size()> values = meter::map.read([&](const RegisterMapRequest& request) {
+        function_codes.push_back(request.function_code);
+        return device.at(request.first_register_address);
+    });
+
+    EXPECT_EQ(function_codes, (std::vector<uint8_t>{3, 3, 4}));
+    EXPECT_FLOAT_EQ(values[meter::map.index_of("voltage_l1")], 123.456f);
+    EXPECT_DOUBLE_EQ(values[meter::map.index_of("frequency")], 50.0);
+    EXPECT_DOUBLE_EQ(values[meter::map.index_of("current_l1")], -10.0);
+    EXPECT_DOUBLE_EQ(values[meter::map.index_of("energy_import")], 65536 * 0.001);
+    EXPECT_DOUBLE_EQ(values[meter::map.index_of("temperature")], -10.0);
+
+    EXPECT_EQ(meter::map.request_body(1), utils::build_read_holding_register_message_body(0x0100, 4));
+    EXPECT_THROW(meter::map.index_of("power"), exceptions::register_map_error);
+    EXPECT_THROW(meter::map.decode(0, DataVectorUint8(4), values), exceptions::message_size_exception);
+}
+
+TEST(RTUTests, test_encode_adu) {
+
+    using namespace everest::modbus;
+
+    // sunspec get_common request, see test_rtu_client_read_holding_register
+    utils::rtu::AduBuffer buffer;
+    std::size_t pdu_size = utils::encode_read_command_message_body(
+        ByteSpan(buffer).subspan(consts::rtu::ADDRESS_LENGTH), consts::READ_HOLDING_REGISTER_FUNCTION_CODE, 40004, 66);
+    std::size_t adu_size = utils::rtu::encode_adu(buffer, 0x2A, pdu_size);
+
+    DataVectorUint8 expected{0x2A, 0x03, 0x9C, 0x44, 0x00, 0x42, 0xAD, 0xA5};
+    ASSERT_EQ(DataVectorUint8(buffer.begin(), buffer.begin() + adu_size), expected);
+
+    // buffers that are too small are reported, not overrun
+    uint8_t small_buffer[4];
+    EXPECT_THROW(utils::encode_read_command_message_body(small_buffer, consts::READ_HOLDING_REGISTER_FUNCTION_CODE,
+                                                         40004, 66),
+                 exceptions::message_size_exception);
+    EXPECT_THROW(utils::rtu::encode_adu(buffer, 0x2A, consts::rtu::MAX_PDU + 1), exceptions::message_size_exception);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // test serial connection helper stuff
@@ -346,6 +554,124 @@ TEST(RTUClientTest, test_rtu_client_read_holding_register) {
     }
 }
 
+TEST(RTUClientTest, test_rtu_client_read_holding_register_view) {
+
+    // the view points into the receive buffer of the client instead of a copy
+
+    using namespace ::everest::modbus;
+    using namespace ::everest::connection;
+
+    using ::testing::_;
+    using ::testing::DoAll;
+    using ::testing::NiceMock;
+    using ::testing::Return;
+    using ::testing::SetArrayArgument;
+
+    NiceMock<MockSerialDevice> serial_device;
+
+    // read two registers from unit 0x2A, the request is echoed in front of the response
+    DataVectorUint8 outgoing_request{0x2A, 0x03, 0x00, 0x01, 0x00, 0x02};
+    utils::CRCResultType crc = utils::calcCRC_16_ANSI(outgoing_request.data(), outgoing_request.size());
+    outgoing_request.push_back(crc >> 8);
+    outgoing_request.push_back(crc & 0xff);
+
+    DataVectorUint8 incomming_response{0x2A, 0x03, 0x04, 0x12, 0x34, 0x56, 0x78};
+    crc = utils::calcCRC_16_ANSI(incomming_response.data(), incomming_response.size());
+    incomming_response.push_back(crc >> 8);
+    incomming_response.push_back(crc & 0xff);
+    incomming_response.insert(incomming_response.begin(), outgoing_request.begin(), outgoing_request.end());
+
+    EXPECT_CALL(serial_device, read(_, _))
+        .WillOnce(DoAll(SetArrayArgument<0>(incomming_response.begin(), incomming_response.end()),
+                        Return(incomming_response.size())));
+    EXPECT_CALL(serial_device, write(_, _)).WillOnce(Return(outgoing_request.size()));
+
+    RTUConnection connection(serial_device);
+    ModbusRTUClient client(connection, true);
+
+    ConstByteSpan registers = client.read_holding_register_view(0x2A, 0x0001, 2);
+    ASSERT_EQ(DataVectorUint8(registers.begin(), registers.end()), (DataVectorUint8{0x12, 0x34, 0x56, 0x78}));
+}
+
+TEST(RTUClientTest, test_rtu_client_ignore_echo_without_echo) {
+
+    // an adapter that does not echo the request works with ignore_echo as well
+
+    using namespace ::everest::modbus;
+    using namespace ::everest::connection;
+
+    using ::testing::_;
+    using ::testing::DoAll;
+    using ::testing::InSequence;
+    using ::testing::NiceMock;
+    using ::testing::Return;
+    using ::testing::SetArrayArgument;
+
+    NiceMock<MockSerialDevice> serial_device;
+
+    DataVectorUint8 incomming_response{0x2A, 0x03, 0x04, 0x12, 0x34, 0x56, 0x78};
+    utils::CRCResultType crc = utils::calcCRC_16_ANSI(incomming_response.data(), incomming_response.size());
+    incomming_response.push_back(crc >> 8);
+    incomming_response.push_back(crc & 0xff);
+
+    {
+        InSequence sequence;
+        EXPECT_CALL(serial_device, read(_, utils::rtu::RESPONSE_HEADER_LENGTH))
+            .WillOnce(DoAll(SetArrayArgument<0>(incomming_response.begin(), incomming_response.begin() + 3),
+                            Return(3)));
+        EXPECT_CALL(serial_device, read(_, incomming_response.size() - 3))
+            .WillOnce(DoAll(SetArrayArgument<0>(incomming_response.begin() + 3, incomming_response.end()),
+                            Return(incomming_response.size() - 3)));
+    }
+    EXPECT_CALL(serial_device, write(_, _)).WillOnce(Return(8));
+
+    RTUConnection connection(serial_device);
+    ModbusRTUClient client(connection, true);
+
+    ConstByteSpan registers = client.read_holding_register_view(0x2A, 0x0001, 2);
+    ASSERT_EQ(DataVectorUint8(registers.begin(), registers.end()), (DataVectorUint8{0x12, 0x34, 0x56, 0x78}));
+}
+
+TEST(RTUClientTest, test_rtu_client_reads_exact_frame_length) {
+
+    // the response is read in two steps: the header, which tells the length of the frame, and the rest of it. No read
+    // has to wait for a timeout at the end of the frame.
+
+    using namespace ::everest::modbus;
+    using namespace ::everest::connection;
+
+    using ::testing::_;
+    using ::testing::DoAll;
+    using ::testing::InSequence;
+    using ::testing::NiceMock;
+    using ::testing::Return;
+    using ::testing::SetArrayArgument;
+
+    NiceMock<MockSerialDevice> serial_device;
+
+    DataVectorUint8 incomming_response{0x2A, 0x03, 0x04, 0x12, 0x34, 0x56, 0x78};
+    utils::CRCResultType crc = utils::calcCRC_16_ANSI(incomming_response.data(), incomming_response.size());
+    incomming_response.push_back(crc >> 8);
+    incomming_response.push_back(crc & 0xff);
+
+    {
+        InSequence sequence;
+        EXPECT_CALL(serial_device, read(_, utils::rtu::RESPONSE_HEADER_LENGTH))
+            .WillOnce(DoAll(SetArrayArgument<0>(incomming_response.begin(), incomming_response.begin() + 3),
+                            Return(3)));
+        EXPECT_CALL(serial_device, read(_, incomming_response.size() - 3))
+            .WillOnce(DoAll(SetArrayArgument<0>(incomming_response.begin() + 3, incomming_response.end()),
+                            Return(incomming_response.size() - 3)));
+    }
+    EXPECT_CALL(serial_device, write(_, _)).WillOnce(Return(8));
+
+    RTUConnection connection(serial_device);
+    ModbusRTUClient client(connection);
+
+    ConstByteSpan registers = client.read_holding_register_view(0x2A, 0x0001, 2);
+    ASSERT_EQ(DataVectorUint8(registers.begin(), registers.end()), (DataVectorUint8{0x12, 0x34, 0x56, 0x78}));
+}
+
 TEST(RTUClientTest, test_rtu_client_read_input_register) {
 
     FAIL() << "\n\n(imagine this message displayed in red, blinking...)\n\n *** needs to be implemented, currently we dont have data for this. ***\n\n";
@@ -529,7 +855,9 @@ TEST(RTUClientTest, test_rtu_client_error_responses) {
 
     DataVectorUint8 incomming_rtu_error_response{0x2A,  // unit id
                                                  0x90,  // error code for 0x10 (write multiple register)
-                                                 0x04}; // some valid error exception code.
+                                                 0x04,  // some valid error exception code.
+                                                 0x3D,
+                                                 0xCB}; // crc16
 
     ModbusDataContainerUint16 payload(ByteOrder::LittleEndian, {0x000a, 0x0102});
 
@@ -570,16 +898,99 @@ TEST(RTUClientTest, test_rtu_message_size_error) {
     RTUConnection connection(serial_device);
     ModbusRTUClient client(connection);
 
-    EXPECT_THROW(client.read_holding_register(42, 40000, everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE + 1),
-                 ::everest::modbus::exceptions::message_size_exception);
-
-    // some nonsense payload
+    // a raw response holds one request only
+    EXPECT_THROW(
+        client.read_holding_register(42, 40000, everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE + 1, false),
+        ::everest::modbus::exceptions::message_size_exception);
+    EXPECT_THROW(
+        client.read_holding_register_view(42, 40000, everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE + 1),
+        ::everest::modbus::exceptions::message_size_exception);
+    EXPECT_THROW(
+        client.read_input_register_view(42, 40000, everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE + 1),
+        ::everest::modbus::exceptions::message_size_exception);
+
+    // some nonsense payload, too short for the number of registers
     ModbusDataContainerUint16 payload(ByteOrder::LittleEndian, {0x000a, 0x0102});
     EXPECT_THROW(client.write_multiple_registers(42, 40000, everest::modbus::consts::rtu::MAX_REGISTER_PER_MESSAGE + 1,
                                                  payload, true),
                  ::everest::modbus::exceptions::message_size_exception);
 }
 
+TEST(RTUClientTest, test_rtu_client_chunked_read_and_write) {
+
+    using namespace ::everest::modbus;
+    using namespace ::everest::connection;
+    using ::testing::_;
+    using ::testing::Invoke;
+
+    // the mocked device plays a server whose registers hold their own address
+    std::vector<uint8_t> pending_response;
+    std::vector<std::pair<uint16_t, uint16_t>> requests; // first register, number of registers
+    std::map<uint16_t, uint16_t> written;
+
+    ::testing::NiceMock<MockSerialDevice> serial_device;
+    ON_CALL(serial_device, write(_, _)).WillByDefault(Invoke([&](const unsigned char* request, ::size_t count) {
+        const uint16_t first = (request[2] << 8) | request[3];
+        const uint16_t num = (request[4] << 8) | request[5];
+        requests.emplace_back(first, num);
+
+        utils::rtu::AduBuffer response;
+        std::size_t pdu_size;
+        if (request[1] == consts::READ_HOLDING_REGISTER_FUNCTION_CODE) {
+            response[1] = request[1];
+            response[2] = 2 * num;
+            for (uint16_t index = 0; index < num; ++index) {
+                response[3 + 2 * index] = (first + index) >> 8;
+                response[4 + 2 * index] = (first + index) & 0xff;
+            }
+            pdu_size = 2 + 2 * num;
+        } else {
+            for (uint16_t index = 0; index < num; ++index)
+                written[first + index] = (request[7 + 2 * index] << 8) | request[8 + 2 * index];
+            std::copy(request + 1, request + 6, response.begin() + 1);
+            pdu_size = 5;
+        }
+        pending_response.assign(response.begin(),
+                                response.begin() + utils::rtu::encode_adu(response, request[0], pdu_size));
+        return count;
+    }));
+    ON_CALL(serial_device, read(_, _)).WillByDefault(Invoke([&](unsigned char* buffer, ::size_t count) {
+        const std::size_t size = std::min(count, pending_response.size());
+        std::copy(pending_response.begin(), pending_response.begin() + size, buffer);
+        pending_response.erase(pending_response.begin(), pending_response.begin() + size);
+        return size;
+    }));
+
+    RTUConnection connection(serial_device);
+    ModbusRTUClient client(connection);
+
+    DataVectorUint8 registers = client.read_holding_register(0x2A, 0x0100, 300);
+    ASSERT_EQ(registers.size(), 600);
+    for (uint16_t index = 0; index < 300; ++index)
+        ASSERT_EQ((registers[2 * index] << 8) | registers[2 * index + 1], 0x0100 + index);
+    EXPECT_THAT(requests, ::testing::ElementsAre(std::make_pair(0x0100, 125), std::make_pair(0x017D, 125),
+                                                 std::make_pair(0x01FA, 50)));
+
+    // a range larger than one request, into a buffer of the caller
+    requests.clear();
+    std::array<uint8_t, 260> buffer;
+    EXPECT_EQ(client.read_holding_register_into(0x2A, 0x0000, 130, buffer), 260);
+    EXPECT_EQ(buffer[259], 129);
+    EXPECT_EQ(requests.size(), 2);
+
+    requests.clear();
+    DataVectorUint16 values(250);
+    for (uint16_t index = 0; index < values.size(); ++index)
+        values[index] = 0x1000 + index;
+    client.write_multiple_registers(0x2A, 0x0200, values.size(),
+                                    ModbusDataContainerUint16(ByteOrder::LittleEndian, values), false);
+    EXPECT_THAT(requests, ::testing::ElementsAre(std::make_pair(0x0200, 123), std::make_pair(0x027B, 123),
+                                                 std::make_pair(0x02F6, 4)));
+    ASSERT_EQ(written.size(), 250);
+    EXPECT_EQ(written[0x0200], 0x1000);
+    EXPECT_EQ(written[0x02F9], 0x10F9);
+}
+
 TEST(RTUClientTest, test_response_without_protocol_data) {
 
     // test the unpacking of response data ( stripping the protocol part from the response data )
@@ -610,3 +1021,149 @@ TEST(RTUClientTest, test_response_without_protocol_data) {
 
     ASSERT_EQ(ModbusRTUClient::response_without_protocol_data(dv_raw_resrponse, 0x84), dv_stripped_response);
 }
+
+TEST(RTUBusSchedulerTest, test_priorities_and_fairness) {
+
+    using namespace everest::modbus;
+    using Priority = ModbusRTUBusScheduler::Priority;
+
+    ::testing::NiceMock<MockSerialDevice> serial_device;
+    everest::connection::RTUConnection connection(serial_device);
+    ModbusRTUBusScheduler scheduler(connection);
+
+    // the first transaction blocks the bus until all others are queued
+    std::promise<void> bus_released;
+    std::shared_future<void> bus_free = bus_released.get_future().share();
+    std::vector<std::string> order; // only touched by the worker thread
+    auto transaction = [&order](std::string name) {
+        return [&order, name](const ModbusRTUClient&) {
+            order.push_back(name);
+            return DataVectorUint8{};
+        };
+    };
+
+    std::future<DataVectorUint8> blocking = scheduler.submit(9, [bus_free](const ModbusRTUClient&) {
+        bus_free.wait();
+        return DataVectorUint8{0x09};
+    });
+    std::vector<std::future<DataVectorUint8>> results;
+    results.push_back(scheduler.submit(1, transaction("1 low"), Priority::Low));
+    results.push_back(scheduler.submit(1, transaction("1 normal a")));
+    results.push_back(scheduler.submit(1, transaction("1 normal b")));
+    results.push_back(scheduler.submit(1, transaction("1 normal c")));
+    results.push_back(scheduler.submit(2, transaction("2 normal")));
+    results.push_back(scheduler.submit(3, transaction("3 high"), Priority::High));
+
+    bus_released.set_value();
+    EXPECT_EQ(blocking.get(), DataVectorUint8{0x09});
+    for (auto& result : results)
+        result.get();
+
+    // high priority first, then the units take turns
+    EXPECT_THAT(order, ::testing::ElementsAre("3 high", "1 normal a", "2 normal", "1 normal b", "1 normal c", "1 low"));
+}
+
+TEST(RTUBusSchedulerTest, test_silent_units_are_suspended) {
+
+    using namespace everest::modbus;
+
+    ::testing::NiceMock<MockSerialDevice> serial_device;
+    everest::connection::RTUConnection connection(serial_device);
+    ModbusRTUBusScheduler scheduler(connection);
+    scheduler.set_suspension(2, std::chrono::milliseconds(50), std::chrono::milliseconds(200));
+
+    // the mocked device never answers
+    EXPECT_THROW(scheduler.read_holding_register(5, 0x0001, 2).get(), exceptions::empty_response);
+    EXPECT_FALSE(scheduler.is_suspended(5));
+
+    std::promise<void> bus_released;
+    std::shared_future<void> bus_free = bus_released.get_future().share();
+    std::future<DataVectorUint8> blocking = scheduler.submit(6, [bus_free](const ModbusRTUClient&) {
+        bus_free.wait();
+        return DataVectorUint8{};
+    });
+    std::future<DataVectorUint8> second_failure = scheduler.read_input_register(5, 0x0001, 2);
+    bool queued_transaction_ran = false;
+    std::future<DataVectorUint8> queued = scheduler.submit(5, [&queued_transaction_ran](const ModbusRTUClient&) {
+        queued_transaction_ran = true;
+        return DataVectorUint8{};
+    });
+    bus_released.set_value();
+
+    // the second failure suspends the unit, its queued request fails without using the bus
+    EXPECT_THROW(second_failure.get(), exceptions::empty_response);
+    EXPECT_THROW(queued.get(), exceptions::unit_suspended);
+    EXPECT_FALSE(queued_transaction_ran);
+    EXPECT_TRUE(scheduler.is_suspended(5));
+    EXPECT_THROW(scheduler.read_holding_register(5, 0x0001, 2).get(), exceptions::unit_suspended);
+
+    // other units are not affected
+    EXPECT_EQ(scheduler.submit(6, [](const ModbusRTUClient&) { return DataVectorUint8{0x06}; }).get(),
+              DataVectorUint8{0x06});
+
+    // after the suspension the unit is tried again, staying silent suspends it again
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_FALSE(scheduler.is_suspended(5));
+    EXPECT_THROW(scheduler.read_holding_register(5, 0x0001, 2).get(), exceptions::empty_response);
+    EXPECT_TRUE(scheduler.is_suspended(5));
+}
+
+TEST(ReadPlannerTest, test_plan_and_scatter) {
+
+    using namespace everest::modbus;
+    using Read = ReadPlanner::Read;
+    using Request = ReadPlanner::Request;
+
+    ReadPlanner planner;
+    planner.set_gap_tolerance(5);
+    planner.add_forbidden_range(1, consts::READ_HOLDING_REGISTER_FUNCTION_CODE, 0x0005, 1);
+
+    const std::vector<Read> reads{
+        {1, 0x0020, 2},                                           // too far away from the others
+        {1, 0x0002, 2},                                           // adjacent to the next one
+        {1, 0x0000, 2},
+        {1, 0x0008, 1},                                           // the gap to 0x0003 contains the forbidden 0x0005
+        {1, 0x000A, 2},                                           // one register gap to 0x0008
+        {2, 0x0000, 2, consts::READ_INPUT_REGISTER_FUNCTION_CODE} // other unit
+    };
+
+    std::vector<Request> requests = planner.plan(reads);
+    ASSERT_EQ(requests.size(), 4);
+    EXPECT_EQ(requests[0].first_register_address, 0x0000);
+    EXPECT_EQ(requests[0].num_registers, 4);
+    EXPECT_THAT(requests[0].reads, ::testing::ElementsAre(2, 1));
+    EXPECT_EQ(requests[1].first_register_address, 0x0008);
+    EXPECT_EQ(requests[1].num_registers, 4);
+    EXPECT_EQ(requests[2].first_register_address, 0x0020);
+    EXPECT_EQ(requests[3].unit_id, 2);
+    EXPECT_EQ(requests[3].function_code, consts::READ_INPUT_REGISTER_FUNCTION_CODE);
+
+    // each register holds its address, unit 2 does not answer
+    std::vector<ReadPlanner::ReadResult> results = planner.read(reads, [](const Request& request) {
+        if (request.unit_id == 2)
+            throw exceptions::empty_response("no response");
+        DataVectorUint8 registers;
+        for (uint16_t address = request.first_register_address;
+             address < request.first_register_address + request.num_registers; ++address) {
+            registers.push_back(address >> 8);
+            registers.push_back(address & 0xff);
+        }
+        return registers;
+    });
+    ASSERT_EQ(results.size(), reads.size());
+    EXPECT_EQ(results[0].registers, (DataVectorUint8{0x00, 0x20, 0x00, 0x21}));
+    EXPECT_EQ(results[1].registers, (DataVectorUint8{0x00, 0x02, 0x00, 0x03}));
+    EXPECT_EQ(results[3].registers, (DataVectorUint8{0x00, 0x08}));
+    EXPECT_EQ(results[4].registers, (DataVectorUint8{0x00, 0x0A, 0x00, 0x0B}));
+    EXPECT_TRUE(results[5].registers.empty());
+    EXPECT_THROW(std::rethrow_exception(results[5].error), exceptions::empty_response);
+
+    // requests never exceed the limit
+    planner.set_max_registers_per_request(3);
+    requests = planner.plan({{1, 0x0000, 2}, {1, 0x0002, 2}});
+    ASSERT_EQ(requests.size(), 2);
+    EXPECT_THROW(planner.plan({{1, 0x0000, 4}}), exceptions::message_size_exception);
+
+    // coils are no registers
+    EXPECT_THROW(planner.plan({{1, 0x0000, 2, consts::READ_COILS_FUNCTION_CODE}}), std::invalid_argument);
+}
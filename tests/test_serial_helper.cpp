@@ -6,6 +6,35 @@
 
 #include <connection/serial_connection_helper.hpp>
 
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+
+// pseudo terminal as stand in for a serial device, the master side plays the role of the remote device
+class PseudoTerminal {
+public:
+    PseudoTerminal() {
+        m_master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+        grantpt(m_master_fd);
+        unlockpt(m_master_fd);
+    }
+    ~PseudoTerminal() {
+        close(m_master_fd);
+    }
+
+    int master_fd() const {
+        return m_master_fd;
+    }
+    std::string device() const {
+        return ptsname(m_master_fd);
+    }
+
+private:
+    int m_master_fd;
+};
+
 TEST(TestSerialHelper, testSerialHelperConfiguration) {
 
     using namespace everest::connection;
@@ -48,3 +77,107 @@ TEST(TestSerialHelper, BaudFromInt) {
         EXPECT_FALSE(result.conversion_ok);
     }
 }
+
+TEST(TestSerialHelper, SilentIntervals) {
+
+    using namespace everest::connection;
+
+    SerialDeviceConfiguration config{};
+    config.set_sensible_defaults()
+        .set_baud_rate(SerialDeviceConfiguration::BaudRate::Baud_9600)
+        .set_data_bits(SerialDeviceConfiguration::DataBits::Bit_8)
+        .set_stop_bits(SerialDeviceConfiguration::StopBits::One)
+        .set_parity(SerialDeviceConfiguration::Parity::Even);
+
+    // 11 bits per character
+    EXPECT_EQ(config.character_time(), std::chrono::microseconds(1146));
+    EXPECT_EQ(config.t1_5(), std::chrono::microseconds(1719));
+    EXPECT_EQ(config.t3_5(), std::chrono::microseconds(4011));
+
+    config.set_parity(SerialDeviceConfiguration::Parity::None).set_stop_bits(SerialDeviceConfiguration::StopBits::Two);
+    EXPECT_EQ(config.character_time(), std::chrono::microseconds(1146));
+
+    // fixed values above 19200 baud
+    config.set_baud_rate(SerialDeviceConfiguration::BaudRate::Baud_115200);
+    EXPECT_EQ(config.t1_5(), std::chrono::microseconds(750));
+    EXPECT_EQ(config.t3_5(), std::chrono::microseconds(1750));
+}
+
+TEST(TestSerialHelper, ReadDrainsAvailableBytes) {
+
+    using namespace everest::connection;
+
+    PseudoTerminal terminal;
+    SerialDeviceConfiguration config(terminal.device());
+    config.set_sensible_defaults().set_parity(SerialDeviceConfiguration::Parity::None); // ptys reject parity
+    config.initial_read_timeout = std::chrono::milliseconds(100);
+    config.read_timeout = std::chrono::milliseconds(10);
+
+    SerialDevice device(config);
+    device.open();
+
+    const unsigned char frame[]{0x2A, 0x03, 0x04, 0x12, 0x34, 0x56, 0x78, 0x00, 0x00};
+    ASSERT_EQ(write(terminal.master_fd(), frame, sizeof(frame)), sizeof(frame));
+
+    // everything is returned although the buffer is larger, after the read timeout
+    unsigned char buffer[256]{};
+    ASSERT_EQ(device.read(buffer, sizeof(buffer)), sizeof(frame));
+    EXPECT_TRUE(std::equal(frame, frame + sizeof(frame), buffer));
+
+    // nothing to read: returns after the initial timeout
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(device.read(buffer, sizeof(buffer)), 0);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+
+    device.close();
+}
+
+TEST(TestSerialHelper, ReadFrameStopsAfterInterByteTimeout) {
+
+    using namespace everest::connection;
+
+    PseudoTerminal terminal;
+    SerialDeviceConfiguration config(terminal.device());
+    config.set_sensible_defaults().set_parity(SerialDeviceConfiguration::Parity::None); // ptys reject parity
+    config.initial_read_timeout = std::chrono::seconds(2);
+    config.read_timeout = std::chrono::milliseconds(10);
+
+    SerialDevice device(config);
+    device.open();
+
+    // header of a response with 4 register bytes, the rest of the frame never arrives
+    const unsigned char header[]{0x2A, 0x03, 0x04};
+    ASSERT_EQ(write(terminal.master_fd(), header, sizeof(header)), sizeof(header));
+
+    const FrameFormat format{sizeof(header), [](const unsigned char* frame_header) -> ::size_t {
+                                 return 3 + frame_header[2] + 2;
+                             }};
+    unsigned char buffer[256]{};
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(device.read_frame(buffer, sizeof(buffer), format), sizeof(header));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, config.initial_read_timeout);
+
+    device.close();
+}
+
+TEST(TestSerialHelper, DeprecatedDecisecondTimeouts) {
+
+    using namespace everest::connection;
+
+    PseudoTerminal terminal;
+    SerialDeviceConfiguration config(terminal.device());
+    config.set_sensible_defaults().set_parity(SerialDeviceConfiguration::Parity::None); // ptys reject parity
+    config.initial_read_timeout = std::chrono::seconds(5);
+    config.initial_read_timeout_deciseconds = 1; // takes precedence
+
+    SerialDevice device(config);
+    device.open();
+
+    unsigned char buffer[16]{};
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(device.read(buffer, sizeof(buffer)), 0);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+
+    device.close();
+}
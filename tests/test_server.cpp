@@ -0,0 +1,321 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <connection/connection.hpp>
+#include <consts.hpp>
+#include <modbus/exceptions.hpp>
+#include <modbus/modbus_client.hpp>
+#include <modbus/modbus_server.hpp>
+#include <modbus/register_bank.hpp>
+#include <modbus/register_cache.hpp>
+#include <modbus/utils.hpp>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace everest::modbus;
+using Table = RegisterBank::Table;
+
+TEST(RegisterBankTest, test_read_write) {
+
+    RegisterBank bank(10, 10, 4, 4);
+
+    const uint16_t values[]{0x1234, 0xABCD};
+    bank.write(Table::HoldingRegisters, 2, values, 2);
+    EXPECT_EQ(bank.read(Table::HoldingRegisters, 3), 0xABCD);
+
+    uint8_t bytes[4];
+    ASSERT_EQ(bank.read_as_bytes(Table::HoldingRegisters, 2, 2, bytes), 4);
+    EXPECT_THAT(bytes, ::testing::ElementsAre(0x12, 0x34, 0xAB, 0xCD));
+
+    // bits are packed lsb first
+    const uint16_t bits[]{1, 0, 1, 1, 0, 0, 0, 0, 1};
+    bank.write(Table::Coils, 1, bits, 9);
+    ASSERT_EQ(bank.read_as_bytes(Table::Coils, 1, 9, bytes), 2);
+    EXPECT_EQ(bytes[0], 0x0D);
+    EXPECT_EQ(bytes[1], 0x01);
+
+    EXPECT_THROW(bank.write(Table::InputRegisters, 3, values, 2), std::out_of_range);
+    EXPECT_THROW(bank.read(Table::DiscreteInputs, 10), std::out_of_range);
+}
+
+TEST(RegisterBankTest, test_readers_see_consistent_snapshots) {
+
+    // the writer sets all registers to the same value, readers must never see a mix of two writes
+    constexpr std::size_t num_registers = 64;
+    RegisterBank bank(0, 0, num_registers, 0);
+    std::atomic<bool> done{false};
+
+    std::thread writer([&]() {
+        uint16_t values[num_registers];
+        for (uint16_t round = 1; round < 5000; ++round) {
+            std::fill(std::begin(values), std::end(values), round);
+            bank.write(Table::HoldingRegisters, 0, values, num_registers);
+        }
+        done = true;
+    });
+
+    uint16_t snapshot[num_registers];
+    while (not done) {
+        bank.read(Table::HoldingRegisters, 0, snapshot, num_registers);
+        for (uint16_t value : snapshot)
+            ASSERT_EQ(value, snapshot[0]);
+    }
+    writer.join();
+}
+
+TEST(ServerTest, test_process_request_pdu) {
+
+    RegisterBank bank(16, 16, 16, 16);
+    ModbusServer server(bank);
+    uint8_t response[consts::tcp::MAX_PDU];
+
+    auto process = [&](std::vector<uint8_t> request) {
+        std::size_t size = server.process_request_pdu(request, response);
+        return std::vector<uint8_t>(response, response + size);
+    };
+
+    // write multiple coils, then read them back
+    EXPECT_EQ(process({0x0F, 0x00, 0x02, 0x00, 0x0A, 0x02, 0xCD, 0x01}),
+              (std::vector<uint8_t>{0x0F, 0x00, 0x02, 0x00, 0x0A}));
+    EXPECT_EQ(process({0x01, 0x00, 0x02, 0x00, 0x0A}), (std::vector<uint8_t>{0x01, 0x02, 0xCD, 0x01}));
+
+    // write single register, read it back
+    EXPECT_EQ(process({0x06, 0x00, 0x0F, 0xBE, 0xEF}), (std::vector<uint8_t>{0x06, 0x00, 0x0F, 0xBE, 0xEF}));
+    EXPECT_EQ(process({0x03, 0x00, 0x0F, 0x00, 0x01}), (std::vector<uint8_t>{0x03, 0x02, 0xBE, 0xEF}));
+
+    // exception responses
+    EXPECT_EQ(process({0x2B, 0x0E, 0x01, 0x00}), (std::vector<uint8_t>{0xAB, consts::ILLEGAL_FUNCTION}));
+    EXPECT_EQ(process({0x04, 0x00, 0x0F, 0x00, 0x02}), (std::vector<uint8_t>{0x84, consts::ILLEGAL_DATA_ADDRESS}));
+    EXPECT_EQ(process({0x04, 0x00, 0x00, 0x00, 0x7E}), (std::vector<uint8_t>{0x84, consts::ILLEGAL_DATA_VALUE}));
+    EXPECT_EQ(process({0x05, 0x00, 0x00, 0x12, 0x34}), (std::vector<uint8_t>{0x85, consts::ILLEGAL_DATA_VALUE}));
+    EXPECT_EQ(process({0x10, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00}),
+              (std::vector<uint8_t>{0x90, consts::ILLEGAL_DATA_VALUE}));
+}
+
+TEST(ServerTest, test_tcp_server_with_client) {
+
+    RegisterBank bank(0, 0, 300, 32);
+    const uint16_t input_registers[]{0x0102, 0x0304};
+    bank.write(Table::InputRegisters, 4, input_registers, 2);
+
+    ModbusTCPServer server(bank, 0, "127.0.0.1");
+    server.set_unit_ids({1});
+    std::thread server_thread([&server]() { server.run(); });
+
+    {
+        everest::connection::TCPConnection connection("127.0.0.1", server.port());
+        ModbusTCPClient client(connection);
+
+        // the application updates the bank while the server is running
+        const uint16_t holding_registers[]{0xCAFE, 0x0042};
+        bank.write(Table::HoldingRegisters, 10, holding_registers, 2);
+        EXPECT_EQ(client.read_holding_register(1, 10, 2), (DataVectorUint8{0xCA, 0xFE, 0x00, 0x42}));
+
+        // ranges larger than one request are read in pipelined chunks
+        DataVectorUint8 long_range = client.read_holding_register(1, 0, 300);
+        ASSERT_EQ(long_range.size(), 600);
+        EXPECT_EQ(long_range[23], 0x42);
+
+        // several requests in flight on one connection
+        std::vector<ModbusTCPClient::TransactionResult> results = client.read_registers_pipelined(
+            {{1, 4, 2, consts::READ_INPUT_REGISTER_FUNCTION_CODE}, {1, 11, 1}, {1, 299, 2}});
+        ASSERT_EQ(results.size(), 3);
+        EXPECT_EQ(results[0].response, (DataVectorUint8{0x01, 0x02, 0x03, 0x04}));
+        EXPECT_EQ(results[1].response, (DataVectorUint8{0x00, 0x42}));
+        ASSERT_TRUE(results[2].error);
+        EXPECT_THROW(std::rethrow_exception(results[2].error), exceptions::modbus_exception);
+
+        // unit not served by this server
+        try {
+            client.read_holding_register(2, 0, 1);
+            FAIL() << "expected an exception response";
+        } catch (const exceptions::modbus_exception& e) {
+            EXPECT_EQ(e.modbus_exception_code, consts::GATEWAY_TARGET_FAILED_TO_RESPOND);
+        }
+    }
+
+    server.stop();
+    server_thread.join();
+}
+
+TEST(ServerTest, test_rtu_server) {
+
+    // a pseudo terminal stands in for the serial line, its master side plays the client
+    int master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    ASSERT_NE(master_fd, -1);
+    grantpt(master_fd);
+    unlockpt(master_fd);
+
+    everest::connection::SerialDeviceConfiguration config(ptsname(master_fd));
+    config.set_sensible_defaults()
+        .set_baud_rate(everest::connection::SerialDeviceConfiguration::BaudRate::Baud_115200)
+        .set_parity(everest::connection::SerialDeviceConfiguration::Parity::None); // ptys reject parity
+    config.initial_read_timeout = std::chrono::milliseconds(100);
+    config.read_timeout = std::chrono::milliseconds(0);
+    everest::connection::SerialDevice device(config);
+    device.open();
+
+    RegisterBank bank(0, 0, 8, 0);
+    bank.write(Table::HoldingRegisters, 1, 0x1234);
+    ModbusRTUServer server(bank, device, {0x2A});
+
+    auto send_request = [master_fd](std::vector<uint8_t> pdu, uint8_t unit_id) {
+        utils::rtu::AduBuffer adu;
+        std::copy(pdu.begin(), pdu.end(), adu.begin() + 1);
+        std::size_t size = utils::rtu::encode_adu(adu, unit_id, pdu.size());
+        ASSERT_EQ(write(master_fd, adu.data(), size), size);
+    };
+    auto receive_reply = [master_fd]() {
+        std::vector<uint8_t> reply(256);
+        pollfd poll_fd{master_fd, POLLIN, 0};
+        std::size_t received = 0;
+        while (poll(&poll_fd, 1, 100) > 0) {
+            ssize_t bytes = read(master_fd, reply.data() + received, reply.size() - received);
+            if (bytes <= 0)
+                break;
+            received += bytes;
+        }
+        reply.resize(received);
+        return reply;
+    };
+
+    // read one holding register
+    send_request({0x03, 0x00, 0x01, 0x00, 0x01}, 0x2A);
+    EXPECT_TRUE(server.process_next_request());
+    std::vector<uint8_t> reply = receive_reply();
+    ASSERT_EQ(reply.size(), 7);
+    EXPECT_TRUE(utils::Crc16Modbus().update(reply.data(), reply.size()).frame_valid());
+    EXPECT_EQ(std::vector<uint8_t>(reply.begin(), reply.begin() + 5),
+              (std::vector<uint8_t>{0x2A, 0x03, 0x02, 0x12, 0x34}));
+
+    // requests for other units and broadcasts are not answered, broadcasts are processed
+    send_request({0x03, 0x00, 0x01, 0x00, 0x01}, 0x2B);
+    EXPECT_FALSE(server.process_next_request());
+    send_request({0x10, 0x00, 0x02, 0x00, 0x01, 0x02, 0xAB, 0xCD}, 0x00);
+    EXPECT_TRUE(server.process_next_request());
+    EXPECT_EQ(bank.read(Table::HoldingRegisters, 2), 0xABCD);
+
+    // frames with a broken crc are dropped
+    const uint8_t broken[]{0x2A, 0x03, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00};
+    ASSERT_EQ(write(master_fd, broken, sizeof(broken)), sizeof(broken));
+    EXPECT_FALSE(server.process_next_request());
+    EXPECT_TRUE(receive_reply().empty());
+
+    // The response of another slave is longer than a request with the same function code. It is dropped as a whole,
+    // so the next request does not start with its tail.
+    std::vector<uint8_t> foreign_response{0x2B, 0x03, 0x04, 0x00, 0x01, 0x00, 0x02};
+    utils::CRCResultType crc = utils::calcCRC_16_ANSI(foreign_response.data(), foreign_response.size());
+    foreign_response.push_back(crc >> 8);
+    foreign_response.push_back(crc & 0xff);
+    ASSERT_EQ(write(master_fd, foreign_response.data(), foreign_response.size()), foreign_response.size());
+    EXPECT_FALSE(server.process_next_request());
+    send_request({0x03, 0x00, 0x01, 0x00, 0x01}, 0x2A);
+    EXPECT_TRUE(server.process_next_request());
+    EXPECT_EQ(receive_reply().size(), 7);
+
+    device.close();
+    close(master_fd);
+}
+
+// holds back transactions until the gate is opened, so the test knows they are still in flight
+class GatedClient : public ModbusTCPClient {
+public:
+    GatedClient(everest::connection::TCPConnection& connection, std::shared_future<void> gate) :
+        ModbusTCPClient(connection), m_gate(std::move(gate)) {
+    }
+
+    const DataVectorUint8 read_holding_register(uint8_t unit_id, uint16_t first_register_address,
+                                                uint16_t num_registers_to_read,
+                                                bool return_only_registers_bytes = true) const override {
+        ++num_transactions;
+        m_gate.wait();
+        return ModbusTCPClient::read_holding_register(unit_id, first_register_address, num_registers_to_read,
+                                                      return_only_registers_bytes);
+    }
+
+    mutable std::atomic<std::size_t> num_transactions{0};
+
+private:
+    std::shared_future<void> m_gate;
+};
+
+TEST(RegisterCacheTest, test_ttl_and_single_flight) {
+
+    RegisterBank bank(0, 0, 16, 0);
+    bank.write(Table::HoldingRegisters, 0, 0x0001);
+
+    // the test counts the requests reaching the server
+    ModbusTCPServer server(bank, 0, "127.0.0.1");
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> num_requests{0};
+    std::thread server_thread([&]() {
+        while (not stop)
+            num_requests += server.run_once(std::chrono::milliseconds(10));
+    });
+    // the client may see a response before run_once returned and the request was counted
+    auto requests_served = [&num_requests]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return num_requests.load();
+    };
+
+    {
+        everest::connection::TCPConnection connection("127.0.0.1", server.port());
+        std::promise<void> gate;
+        GatedClient client(connection, gate.get_future().share());
+        RegisterCache cache(client, std::chrono::hours(1));
+        cache.set_ttl(1, 8, 8, std::chrono::milliseconds(0));
+
+        // Concurrent identical reads result in one transaction. It is held back until all readers have missed the
+        // cache, nothing is cached before it completes. A reader not joining it would start a transaction of its own.
+        std::vector<std::thread> readers;
+        std::atomic<std::size_t> num_started{0};
+        std::atomic<std::size_t> num_results{0};
+        for (int reader = 0; reader < 8; ++reader)
+            readers.emplace_back([&]() {
+                ++num_started;
+                if (cache.read_holding_register(1, 0, 2)->registers == DataVectorUint8{0x00, 0x01, 0x00, 0x00})
+                    ++num_results;
+            });
+        while (num_started < readers.size() or client.num_transactions == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        gate.set_value();
+        for (auto& reader : readers)
+            reader.join();
+        EXPECT_EQ(num_results, 8);
+        EXPECT_EQ(client.num_transactions, 1);
+        EXPECT_EQ(requests_served(), 1);
+
+        // hits are served from the cache until it is invalidated, with the time they were sampled at
+        bank.write(Table::HoldingRegisters, 0, 0x0002);
+        RegisterCache::CachedRegistersPtr cached = cache.read_holding_register(1, 0, 2);
+        EXPECT_EQ(cached->registers, (DataVectorUint8{0x00, 0x01, 0x00, 0x00}));
+        EXPECT_LE(cached->sampled_at, RegisterCache::Clock::now());
+        EXPECT_EQ(requests_served(), 1);
+        cache.invalidate(2); // other units keep their entries
+        EXPECT_EQ(cache.read_holding_register(1, 0, 2)->registers, (DataVectorUint8{0x00, 0x01, 0x00, 0x00}));
+        cache.invalidate(1);
+        EXPECT_EQ(cache.read_holding_register(1, 0, 2)->registers, (DataVectorUint8{0x00, 0x02, 0x00, 0x00}));
+        EXPECT_EQ(requests_served(), 2);
+
+        // ranges with a ttl of 0 are not cached
+        cache.read_holding_register(1, 8, 1);
+        cache.read_holding_register(1, 8, 1);
+        EXPECT_EQ(requests_served(), 4);
+    }
+
+    stop = true;
+    server_thread.join();
+}
@@ -0,0 +1,863 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2020 - 2021 Pionix GmbH and Contributors to EVerest
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <connection/connection.hpp>
+#include <connection/event_loop.hpp>
+#include <connection/exceptions.hpp>
+#include <consts.hpp>
+#include <modbus/exceptions.hpp>
+#include <modbus/modbus_async_awaitable.hpp>
+#include <modbus/modbus_async_client.hpp>
+#include <modbus/modbus_client.hpp>
+#include <modbus/utils.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <thread>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Minimal MODBUS/TCP peer on the loopback interface, the test body decides what is sent back.
+
+class LoopbackServer {
+public:
+    using DataVector = std::vector<uint8_t>;
+
+    LoopbackServer() {
+        m_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        bind(m_listen_fd, (sockaddr*)&address, sizeof(address));
+        listen(m_listen_fd, 1);
+        socklen_t address_length = sizeof(address);
+        getsockname(m_listen_fd, (sockaddr*)&address, &address_length);
+        m_port = ntohs(address.sin_port);
+    }
+
+    ~LoopbackServer() {
+        if (m_thread.joinable())
+            m_thread.join();
+        close(m_listen_fd);
+    }
+
+    int port() const {
+        return m_port;
+    }
+
+    // handler is called with the accepted client socket in a separate thread
+    void serve(std::function<void(int)> handler) {
+        m_thread = std::thread([this, handler]() {
+            int client_fd = accept(m_listen_fd, nullptr, nullptr);
+            handler(client_fd);
+            close(client_fd);
+        });
+    }
+
+    static DataVector receive_exactly(int fd, std::size_t count) {
+        DataVector result(count);
+        std::size_t received = 0;
+        while (received < count) {
+            ssize_t bytes = recv(fd, result.data() + received, count - received, 0);
+            if (bytes <= 0)
+                break;
+            received += bytes;
+        }
+        result.resize(received);
+        return result;
+    }
+
+    // reply to a read request, each register holds its own address
+    static DataVector make_read_reply(const DataVector& request) {
+        uint16_t first_register = (request[8] << 8) | request[9];
+        uint16_t num_registers = (request[10] << 8) | request[11];
+        DataVector reply(request.begin(), request.begin() + 8);
+        uint16_t length = 3 + num_registers * 2;
+        reply[4] = length >> 8;
+        reply[5] = length & 0xff;
+        reply.push_back(num_registers * 2);
+        for (uint16_t reg = first_register; reg < first_register + num_registers; ++reg) {
+            reply.push_back(reg >> 8);
+            reply.push_back(reg & 0xff);
+        }
+        return reply;
+    }
+
+private:
+    int m_listen_fd;
+    int m_port;
+    std::thread m_thread;
+};
+
+static const std::size_t read_request_size = everest::modbus::consts::tcp::MBAP_HEADER_LENGTH + 5;
+
+TEST(TCPClientTest, test_pipelined_replies_out_of_order) {
+
+    using namespace everest::modbus;
+
+    LoopbackServer server;
+    server.serve([](int fd) {
+        std::vector<LoopbackServer::DataVector> requests;
+        for (int index = 0; index < 3; ++index)
+            requests.push_back(LoopbackServer::receive_exactly(fd, read_request_size));
+
+        // a reply nobody waits for, then all replies in reverse order within a single segment
+        LoopbackServer::DataVector stale = LoopbackServer::make_read_reply(requests[0]);
+        stale[0] ^= 0xff;
+        LoopbackServer::DataVector segment(stale);
+        for (auto request = requests.rbegin(); request != requests.rend(); ++request) {
+            LoopbackServer::DataVector reply = LoopbackServer::make_read_reply(*request);
+            segment.insert(segment.end(), reply.begin(), reply.end());
+        }
+        send(fd, segment.data(), segment.size(), 0);
+    });
+
+    everest::connection::TCPConnection connection("127.0.0.1", server.port());
+    ModbusTCPClient client(connection);
+    client.set_pipeline_window(3);
+
+    std::vector<ModbusTCPClient::TransactionResult> results =
+        client.read_registers_pipelined({{1, 0x0010, 2}, {1, 0x0100, 1}, {2, 0x1234, 3}});
+
+    ASSERT_EQ(results.size(), 3);
+    for (const auto& result : results)
+        ASSERT_FALSE(result.error);
+    EXPECT_EQ(results[0].response, (DataVectorUint8{0x00, 0x10, 0x00, 0x11}));
+    EXPECT_EQ(results[1].response, (DataVectorUint8{0x01, 0x00}));
+    EXPECT_EQ(results[2].response, (DataVectorUint8{0x12, 0x34, 0x12, 0x35, 0x12, 0x36}));
+}
+
+TEST(TCPClientTest, test_pipelined_transaction_timeout) {
+
+    using namespace everest::modbus;
+
+    LoopbackServer server;
+    server.serve([](int fd) {
+        // the window is 2: answer the second request only, then the third one
+        LoopbackServer::DataVector first = LoopbackServer::receive_exactly(fd, read_request_size);
+        LoopbackServer::DataVector second = LoopbackServer::receive_exactly(fd, read_request_size);
+        LoopbackServer::DataVector reply = LoopbackServer::make_read_reply(second);
+        send(fd, reply.data(), reply.size(), 0);
+
+        LoopbackServer::DataVector third = LoopbackServer::receive_exactly(fd, read_request_size);
+        reply = LoopbackServer::make_read_reply(third);
+        send(fd, reply.data(), reply.size(), 0);
+
+        // wait for the client to hang up
+        LoopbackServer::receive_exactly(fd, 1);
+    });
+
+    everest::connection::TCPConnection connection("127.0.0.1", server.port());
+    ModbusTCPClient client(connection);
+    client.set_pipeline_window(2);
+    client.set_transaction_timeout(std::chrono::milliseconds(100));
+
+    std::vector<ModbusTCPClient::TransactionResult> results =
+        client.read_registers_pipelined({{1, 1, 1}, {1, 2, 1}, {1, 3, 1}});
+
+    ASSERT_EQ(results.size(), 3);
+    ASSERT_TRUE(results[0].error);
+    EXPECT_THROW(std::rethrow_exception(results[0].error), exceptions::transaction_timeout);
+    ASSERT_FALSE(results[1].error);
+    EXPECT_EQ(results[1].response, (DataVectorUint8{0x00, 0x02}));
+    ASSERT_FALSE(results[2].error);
+    EXPECT_EQ(results[2].response, (DataVectorUint8{0x00, 0x03}));
+}
+
+TEST(TCPClientTest, test_pipelined_exception_response) {
+
+    using namespace everest::modbus;
+
+    LoopbackServer server;
+    server.serve([](int fd) {
+        LoopbackServer::DataVector request = LoopbackServer::receive_exactly(fd, read_request_size);
+        LoopbackServer::DataVector reply(request.begin(), request.begin() + 8);
+        reply[5] = 3;     // unit id, function code, exception code
+        reply[7] |= 0x80; // exception response
+        reply.push_back(0x02);
+        send(fd, reply.data(), reply.size(), 0);
+    });
+
+    everest::connection::TCPConnection connection("127.0.0.1", server.port());
+    ModbusTCPClient client(connection);
+
+    std::vector<ModbusTCPClient::TransactionResult> results = client.read_registers_pipelined({{1, 0xffff, 1}});
+
+    ASSERT_EQ(results.size(), 1);
+    ASSERT_TRUE(results[0].error);
+    try {
+        std::rethrow_exception(results[0].error);
+    } catch (const exceptions::modbus_exception& e) {
+        EXPECT_EQ(e.modbus_exception_code, 0x02);
+    }
+}
+
+TEST(TCPClientTest, test_transaction_ids_per_connection) {
+
+    using namespace everest::modbus;
+
+    // UDP sockets can be "connected" without a peer, which is enough to build messages
+    everest::connection::UDPConnection first_connection("127.0.0.1", consts::tcp::DEFAULT_PORT);
+    everest::connection::UDPConnection second_connection("127.0.0.1", consts::tcp::DEFAULT_PORT);
+    ModbusUDPClient first_client(first_connection);
+    ModbusUDPClient second_client(second_connection);
+
+    DataVectorUint8 body = utils::build_read_holding_register_message_body(0x0001, 1);
+
+    // ids count up per client, independent of time and of other clients
+    for (uint16_t expected_id = 0; expected_id < 3; ++expected_id) {
+        DataVectorUint8 message =
+            first_client.full_message_from_body(body, consts::READ_REGISTER_COMMAND_LENGTH, 1);
+        EXPECT_EQ(utils::ip::get_transaction_id(message), expected_id);
+    }
+
+    DataVectorUint8 message = second_client.full_message_from_body(body, consts::READ_REGISTER_COMMAND_LENGTH, 1);
+    EXPECT_EQ(utils::ip::get_transaction_id(message), 0);
+}
+
+TEST(TCPClientTest, test_encode_adu) {
+
+    using namespace everest::modbus;
+
+    utils::ip::AduBuffer buffer;
+    std::size_t pdu_size =
+        utils::encode_read_command_message_body(ByteSpan(buffer).subspan(consts::tcp::MBAP_HEADER_LENGTH),
+                                                consts::READ_INPUT_REGISTER_FUNCTION_CODE, 0x0102, 0x0003);
+    std::size_t adu_size = utils::ip::encode_adu(buffer, 0xABCD, 0x11, pdu_size);
+
+    DataVectorUint8 expected{0xAB, 0xCD, 0x00, 0x00, 0x00, 0x06, 0x11, 0x04, 0x01, 0x02, 0x00, 0x03};
+    ASSERT_EQ(DataVectorUint8(buffer.begin(), buffer.begin() + adu_size), expected);
+}
+
+TEST(TCPClientTest, test_read_holding_register) {
+
+    using namespace everest::modbus;
+
+    LoopbackServer server;
+    server.serve([](int fd) {
+        for (int index = 0; index < 3; ++index) {
+            LoopbackServer::DataVector reply =
+                LoopbackServer::make_read_reply(LoopbackServer::receive_exactly(fd, read_request_size));
+            send(fd, reply.data(), reply.size(), 0);
+        }
+    });
+
+    everest::connection::TCPConnection connection("127.0.0.1", server.port());
+    ModbusTCPClient client(connection);
+
+    DataVectorUint8 raw_response = client.read_holding_register(1, 0x0200, 2, false);
+    ASSERT_EQ(raw_response.size(), consts::tcp::MBAP_HEADER_LENGTH + 2 + 4);
+
+    DataVectorUint8 register_bytes = client.read_holding_register(1, 0x0200, 2);
+    EXPECT_EQ(register_bytes, (DataVectorUint8{0x02, 0x00, 0x02, 0x01}));
+
+    ConstByteSpan register_view = client.read_holding_register_view(1, 0x0300, 1);
+    EXPECT_EQ(DataVectorUint8(register_view.begin(), register_view.end()), (DataVectorUint8{0x03, 0x00}));
+}
+
+TEST(TCPClientTest, test_replies_split_into_segments) {
+
+    using namespace everest::modbus;
+
+    LoopbackServer server;
+    server.serve([](int fd) {
+        // the reply trickles in, a few bytes at a time
+        LoopbackServer::DataVector reply =
+            LoopbackServer::make_read_reply(LoopbackServer::receive_exactly(fd, read_request_size));
+        for (std::size_t offset = 0; offset < reply.size(); offset += 4) {
+            send(fd, reply.data() + offset, std::min<std::size_t>(4, reply.size() - offset), 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    everest::connection::TCPConnection connection("127.0.0.1", server.port());
+    ModbusTCPClient client(connection);
+    EXPECT_EQ(client.read_holding_register(1, 0x0010, 8).size(), 16);
+}
+
+TEST(TCPConnectionTest, test_receive_frame) {
+
+    using namespace everest::modbus;
+
+    const auto reply = [](uint16_t transaction_id, uint16_t num_registers) {
+        LoopbackServer::DataVector request{uint8_t(transaction_id >> 8), uint8_t(transaction_id), 0, 0, 0, 6, 1,
+                                           3, 0, 0, 0, uint8_t(num_registers)};
+        return LoopbackServer::make_read_reply(request);
+    };
+
+    std::promise<void> first_part_received;
+    LoopbackServer server;
+    server.serve([&](int fd) {
+        // two replies and the start of a third one in a single segment
+        LoopbackServer::DataVector segment = reply(1, 1);
+        LoopbackServer::DataVector second = reply(2, 3);
+        LoopbackServer::DataVector third = reply(3, 2);
+        segment.insert(segment.end(), second.begin(), second.end());
+        segment.insert(segment.end(), third.begin(), third.begin() + 5);
+        send(fd, segment.data(), segment.size(), 0);
+
+        first_part_received.get_future().wait();
+        send(fd, third.data() + 5, third.size() - 5, 0);
+    });
+
+    everest::connection::TCPConnection connection("127.0.0.1", server.port());
+    const everest::connection::FrameFormat mbap{utils::ip::FRAME_HEADER_LENGTH, utils::ip::frame_length};
+    utils::ip::AduBuffer buffer;
+
+    EXPECT_EQ(connection.receive_frame(buffer.data(), buffer.size(), mbap, 0), 11);
+    EXPECT_EQ(utils::ip::get_transaction_id(buffer), 1);
+    EXPECT_EQ(connection.receive_frame(buffer.data(), buffer.size(), mbap, 0), 15);
+    EXPECT_EQ(utils::ip::get_transaction_id(buffer), 2);
+
+    // the third reply is incomplete, its first bytes are kept
+    EXPECT_EQ(connection.receive_frame(buffer.data(), buffer.size(), mbap, std::chrono::milliseconds(20)), 0);
+    EXPECT_TRUE(connection.is_valid());
+    first_part_received.set_value();
+    EXPECT_EQ(connection.receive_frame(buffer.data(), buffer.size(), mbap, std::chrono::milliseconds(1000)), 13);
+    EXPECT_EQ(utils::ip::get_transaction_id(buffer), 3);
+}
+
+TEST(TCPConnectionTest, test_send_buffers) {
+
+    LoopbackServer::DataVector header{0x00, 0x07, 0x00, 0x00, 0x00, 0x06, 0x01};
+    LoopbackServer::DataVector body{0x03, 0x00, 0x10, 0x00, 0x02};
+    std::promise<LoopbackServer::DataVector> received;
+    LoopbackServer server;
+    server.serve([&](int fd) { received.set_value(LoopbackServer::receive_exactly(fd, header.size() + body.size())); });
+
+    everest::connection::TCPConnection connection("127.0.0.1", server.port());
+    EXPECT_TRUE(connection.no_delay());
+    connection.set_no_delay(false);
+    EXPECT_FALSE(connection.no_delay());
+    connection.set_no_delay(true);
+
+    const everest::connection::ConstBuffer buffers[]{
+        {header.data(), header.size()}, {nullptr, 0}, {body.data(), body.size()}};
+    EXPECT_EQ(connection.send_buffers(buffers, 3), header.size() + body.size());
+
+    LoopbackServer::DataVector expected(header);
+    expected.insert(expected.end(), body.begin(), body.end());
+    EXPECT_EQ(received.get_future().get(), expected);
+}
+
+TEST(TCPConnectionTest, test_connect_all_and_timeout) {
+
+    using everest::connection::TCPConnection;
+
+    LoopbackServer server;
+    server.serve([](int fd) { LoopbackServer::receive_exactly(fd, 1); });
+
+    // nobody listens on the port of a closed server
+    int refused_port;
+    {
+        LoopbackServer closed_server;
+        refused_port = closed_server.port();
+    }
+
+    // a server that never accepts: once its backlog is full, further handshakes do not complete
+    int backlog_fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(backlog_fd, (sockaddr*)&address, sizeof(address));
+    listen(backlog_fd, 0);
+    socklen_t address_length = sizeof(address);
+    getsockname(backlog_fd, (sockaddr*)&address, &address_length);
+    const int backlog_port = ntohs(address.sin_port);
+    std::vector<TCPConnection::ConnectResult> backlog = TCPConnection::connect_all(
+        {{"127.0.0.1", backlog_port}, {"127.0.0.1", backlog_port}}, std::chrono::milliseconds(100));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<TCPConnection::ConnectResult> results = TCPConnection::connect_all(
+        {{"127.0.0.1", server.port()}, {"127.0.0.1", refused_port}, {"127.0.0.1", backlog_port}},
+        std::chrono::milliseconds(200));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+
+    ASSERT_EQ(results.size(), 3);
+    EXPECT_FALSE(results[0].error);
+    EXPECT_TRUE(results[0].connection->is_valid());
+    ASSERT_TRUE(results[1].error);
+    EXPECT_THROW(std::rethrow_exception(results[1].error), everest::connection::exceptions::tcp::tcp_connection_error);
+    EXPECT_FALSE(results[1].connection->is_valid());
+    ASSERT_TRUE(results[2].error);
+    EXPECT_THROW(std::rethrow_exception(results[2].error), everest::connection::exceptions::timeout_error);
+    EXPECT_FALSE(results[2].connection->is_valid());
+
+    EXPECT_THROW(TCPConnection("127.0.0.1", backlog_port, std::chrono::milliseconds(50)),
+                 everest::connection::exceptions::timeout_error);
+
+    uint8_t byte = 0;
+    results[0].connection->send_bytes(&byte, 1);
+    backlog.clear();
+    close(backlog_fd);
+}
+
+TEST(TCPClientTest, test_receive_timeout) {
+
+    using namespace everest::modbus;
+
+    std::promise<void> first_timed_out;
+    LoopbackServer server;
+    server.serve([&](int fd) {
+        // the first reply is late, it arrives right before the reply to the second request
+        LoopbackServer::DataVector first_reply =
+            LoopbackServer::make_read_reply(LoopbackServer::receive_exactly(fd, read_request_size));
+        first_timed_out.get_future().wait();
+        LoopbackServer::DataVector replies =
+            LoopbackServer::make_read_reply(LoopbackServer::receive_exactly(fd, read_request_size));
+        replies.insert(replies.begin(), first_reply.begin(), first_reply.end());
+        send(fd, replies.data(), replies.size(), 0);
+    });
+
+    everest::connection::TCPConnection connection("127.0.0.1", server.port());
+    connection.set_receive_timeout(std::chrono::milliseconds(50));
+    ModbusTCPClient client(connection);
+
+    uint8_t byte;
+    EXPECT_THROW(connection.receive_bytes(&byte, 1), everest::connection::exceptions::timeout_error);
+    EXPECT_THROW(client.read_holding_register(1, 0x0010, 1), everest::connection::exceptions::timeout_error);
+    EXPECT_TRUE(connection.is_valid());
+    first_timed_out.set_value();
+
+    EXPECT_EQ(client.read_holding_register(1, 0x0020, 1), (DataVectorUint8{0x00, 0x20}));
+}
+
+TEST(UDPConnectionTest, test_receive_timeout) {
+
+    int server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(server_fd, (sockaddr*)&address, sizeof(address));
+    socklen_t address_length = sizeof(address);
+    getsockname(server_fd, (sockaddr*)&address, &address_length);
+
+    everest::connection::UDPConnection connection("127.0.0.1", ntohs(address.sin_port));
+    connection.set_receive_timeout(std::chrono::milliseconds(20));
+    uint8_t buffer[8];
+    EXPECT_THROW(connection.receive_bytes(buffer, sizeof(buffer)), everest::connection::exceptions::timeout_error);
+    EXPECT_TRUE(connection.is_valid());
+
+    // the server answers to the address the datagram came from
+    uint8_t request = 0x42;
+    connection.send_bytes(&request, 1);
+    sockaddr_in client{};
+    socklen_t client_length = sizeof(client);
+    recvfrom(server_fd, buffer, sizeof(buffer), 0, (sockaddr*)&client, &client_length);
+    sendto(server_fd, buffer, 1, 0, (sockaddr*)&client, client_length);
+    EXPECT_EQ(connection.receive_bytes(buffer, sizeof(buffer), std::chrono::milliseconds(1000)), 1);
+    EXPECT_EQ(buffer[0], 0x42);
+    close(server_fd);
+}
+
+TEST(UDPConnectionTest, test_receive_queued_with_zero_timeout) {
+
+    int server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(server_fd, (sockaddr*)&address, sizeof(address));
+    socklen_t address_length = sizeof(address);
+    getsockname(server_fd, (sockaddr*)&address, &address_length);
+
+    everest::connection::UDPConnection connection("127.0.0.1", ntohs(address.sin_port));
+    uint8_t buffer[8];
+    EXPECT_THROW(connection.receive_bytes(buffer, sizeof(buffer), std::chrono::milliseconds(0)),
+                 everest::connection::exceptions::timeout_error);
+
+    // both answers are queued once the first one arrived, the second is taken without waiting
+    uint8_t request = 0x42;
+    connection.send_bytes(&request, 1);
+    sockaddr_in client{};
+    socklen_t client_length = sizeof(client);
+    recvfrom(server_fd, buffer, sizeof(buffer), 0, (sockaddr*)&client, &client_length);
+    const uint8_t answers[]{0x01, 0x02};
+    sendto(server_fd, &answers[0], 1, 0, (sockaddr*)&client, client_length);
+    sendto(server_fd, &answers[1], 1, 0, (sockaddr*)&client, client_length);
+    EXPECT_EQ(connection.receive_bytes(buffer, sizeof(buffer), std::chrono::milliseconds(1000)), 1);
+    EXPECT_EQ(buffer[0], 0x01);
+    EXPECT_EQ(connection.receive_bytes(buffer, sizeof(buffer), std::chrono::milliseconds(0)), 1);
+    EXPECT_EQ(buffer[0], 0x02);
+    close(server_fd);
+}
+
+TEST(UDPClientTest, test_read_registers_batched) {
+
+    using namespace everest::modbus;
+
+    int server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(server_fd, (sockaddr*)&address, sizeof(address));
+    socklen_t address_length = sizeof(address);
+    getsockname(server_fd, (sockaddr*)&address, &address_length);
+
+    // answers the last two of three requests in reverse order, the first one is lost
+    std::thread server([server_fd]() {
+        std::vector<LoopbackServer::DataVector> requests;
+        sockaddr_in client{};
+        socklen_t client_length = sizeof(client);
+        for (int index = 0; index < 3; ++index) {
+            LoopbackServer::DataVector request(consts::tcp::MAX_ADU);
+            request.resize(recvfrom(server_fd, request.data(), request.size(), 0, (sockaddr*)&client, &client_length));
+            requests.push_back(request);
+        }
+        for (int index = 2; index > 0; --index) {
+            LoopbackServer::DataVector reply = LoopbackServer::make_read_reply(requests[index]);
+            sendto(server_fd, reply.data(), reply.size(), 0, (sockaddr*)&client, client_length);
+        }
+    });
+
+    everest::connection::UDPConnection connection("127.0.0.1", ntohs(address.sin_port));
+    ModbusUDPClient client(connection);
+    client.set_transaction_timeout(std::chrono::milliseconds(100));
+    std::vector<ModbusUDPClient::TransactionResult> results =
+        client.read_registers_batched({{1, 0x0010, 1}, {2, 0x0020, 2}, {3, 0x0030, 1}});
+    server.join();
+    close(server_fd);
+
+    ASSERT_EQ(results.size(), 3);
+    ASSERT_TRUE(results[0].error);
+    EXPECT_THROW(std::rethrow_exception(results[0].error), exceptions::transaction_timeout);
+    EXPECT_FALSE(results[1].error);
+    EXPECT_EQ(results[1].response, (DataVectorUint8{0x00, 0x20, 0x00, 0x21}));
+    EXPECT_FALSE(results[2].error);
+    EXPECT_EQ(results[2].response, (DataVectorUint8{0x00, 0x30}));
+}
+
+TEST(UDPClientTest, test_read_registers_batched_refused) {
+
+    using namespace everest::modbus;
+
+    int server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(server_fd, (sockaddr*)&address, sizeof(address));
+    socklen_t address_length = sizeof(address);
+    getsockname(server_fd, (sockaddr*)&address, &address_length);
+
+    // answers all but the last request of the first batch and closes, the second batch is refused
+    std::vector<ModbusUDPClient::ReadRequest> requests(65, {1, 0x0010, 1});
+    std::thread server([server_fd]() {
+        std::vector<LoopbackServer::DataVector> received;
+        sockaddr_in client{};
+        socklen_t client_length = sizeof(client);
+        for (int index = 0; index < 64; ++index) {
+            LoopbackServer::DataVector request(consts::tcp::MAX_ADU);
+            request.resize(recvfrom(server_fd, request.data(), request.size(), 0, (sockaddr*)&client, &client_length));
+            received.push_back(request);
+        }
+        for (int index = 0; index < 63; ++index) {
+            LoopbackServer::DataVector reply = LoopbackServer::make_read_reply(received[index]);
+            sendto(server_fd, reply.data(), reply.size(), 0, (sockaddr*)&client, client_length);
+        }
+        close(server_fd);
+    });
+
+    everest::connection::UDPConnection connection("127.0.0.1", ntohs(address.sin_port));
+    ModbusUDPClient client(connection);
+    client.set_transaction_timeout(std::chrono::milliseconds(100));
+    std::vector<ModbusUDPClient::TransactionResult> results;
+    EXPECT_NO_THROW(results = client.read_registers_batched(requests));
+    server.join();
+
+    ASSERT_EQ(results.size(), 65);
+    for (int index = 0; index < 63; ++index)
+        EXPECT_FALSE(results[index].error);
+    for (int index = 63; index < 65; ++index) {
+        ASSERT_TRUE(results[index].error);
+        EXPECT_THROW(std::rethrow_exception(results[index].error), exceptions::transaction_timeout);
+    }
+}
+
+TEST(EventLoopTest, test_requests_on_many_endpoints) {
+
+    using namespace everest::modbus;
+    using everest::connection::EventLoop;
+
+    // every server answers its requests in reverse order, split into two segments
+    constexpr int num_endpoints = 3;
+    constexpr int requests_per_endpoint = 2;
+    std::vector<std::unique_ptr<LoopbackServer>> servers;
+    for (int index = 0; index < num_endpoints; ++index) {
+        servers.push_back(std::make_unique<LoopbackServer>());
+        servers.back()->serve([](int fd) {
+            LoopbackServer::DataVector first = LoopbackServer::receive_exactly(fd, read_request_size);
+            LoopbackServer::DataVector second = LoopbackServer::receive_exactly(fd, read_request_size);
+            LoopbackServer::DataVector replies = LoopbackServer::make_read_reply(second);
+            LoopbackServer::DataVector reply = LoopbackServer::make_read_reply(first);
+            replies.insert(replies.end(), reply.begin(), reply.end());
+            send(fd, replies.data(), 5, 0);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            send(fd, replies.data() + 5, replies.size() - 5, 0);
+        });
+    }
+
+    EventLoop loop;
+    std::vector<DataVectorUint8> responses(num_endpoints * requests_per_endpoint);
+    int completed = 0;
+
+    for (int endpoint_index = 0; endpoint_index < num_endpoints; ++endpoint_index) {
+        EventLoop::EndpointId endpoint = loop.add_endpoint("127.0.0.1", servers[endpoint_index]->port());
+        for (uint16_t request_index = 0; request_index < requests_per_endpoint; ++request_index) {
+            utils::ip::AduBuffer buffer;
+            uint16_t first_register = endpoint_index * 0x100 + request_index;
+            std::size_t pdu_size = utils::encode_read_command_message_body(
+                ByteSpan(buffer).subspan(consts::tcp::MBAP_HEADER_LENGTH),
+                consts::READ_HOLDING_REGISTER_FUNCTION_CODE, first_register, 1);
+            std::size_t adu_size = utils::ip::encode_adu(buffer, request_index, 1, pdu_size);
+
+            std::size_t response_index = endpoint_index * requests_per_endpoint + request_index;
+            loop.submit(endpoint, DataVectorUint8(buffer.begin(), buffer.begin() + adu_size),
+                        [&, response_index](DataVectorUint8 response, std::exception_ptr error) {
+                            EXPECT_FALSE(error);
+                            responses[response_index] = std::move(response);
+                            ++completed;
+                        });
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (completed < num_endpoints * requests_per_endpoint and std::chrono::steady_clock::now() < deadline)
+        loop.run_once(std::chrono::milliseconds(100));
+
+    ASSERT_EQ(completed, num_endpoints * requests_per_endpoint);
+    for (int endpoint_index = 0; endpoint_index < num_endpoints; ++endpoint_index) {
+        for (uint16_t request_index = 0; request_index < requests_per_endpoint; ++request_index) {
+            const DataVectorUint8& response = responses[endpoint_index * requests_per_endpoint + request_index];
+            ASSERT_EQ(response.size(), consts::tcp::MBAP_HEADER_LENGTH + 2 + 2);
+            EXPECT_EQ(utils::ip::get_transaction_id(response), request_index);
+            EXPECT_EQ(response[9], endpoint_index);
+            EXPECT_EQ(response[10], request_index);
+        }
+    }
+}
+
+TEST(EventLoopTest, test_timeout_and_connection_errors) {
+
+    using namespace everest::modbus;
+    using everest::connection::EventLoop;
+
+    LoopbackServer server;
+    server.serve([](int fd) {
+        // never answer, wait for the client to hang up
+        LoopbackServer::receive_exactly(fd, read_request_size + 1);
+    });
+
+    // nobody listens on the port of a closed server
+    int refused_port;
+    {
+        LoopbackServer closed_server;
+        refused_port = closed_server.port();
+    }
+
+    EventLoop loop;
+    EventLoop::EndpointId silent = loop.add_endpoint("127.0.0.1", server.port());
+    EventLoop::EndpointId refused = loop.add_endpoint("127.0.0.1", refused_port);
+
+    utils::ip::AduBuffer buffer;
+    std::size_t pdu_size =
+        utils::encode_read_command_message_body(ByteSpan(buffer).subspan(consts::tcp::MBAP_HEADER_LENGTH),
+                                                consts::READ_HOLDING_REGISTER_FUNCTION_CODE, 0x0001, 1);
+    DataVectorUint8 request(buffer.begin(), buffer.begin() + utils::ip::encode_adu(buffer, 1, 1, pdu_size));
+
+    std::exception_ptr silent_error;
+    std::exception_ptr refused_error;
+    loop.submit(
+        silent, request, [&](DataVectorUint8, std::exception_ptr error) { silent_error = error; },
+        std::chrono::milliseconds(50));
+    loop.submit(refused, request, [&](DataVectorUint8, std::exception_ptr error) { refused_error = error; });
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (not(silent_error and refused_error) and std::chrono::steady_clock::now() < deadline)
+        loop.run_once(std::chrono::milliseconds(100));
+
+    ASSERT_TRUE(silent_error);
+    EXPECT_THROW(std::rethrow_exception(silent_error), everest::connection::exceptions::timeout_error);
+    ASSERT_TRUE(refused_error);
+    EXPECT_THROW(std::rethrow_exception(refused_error), everest::connection::exceptions::communication_error);
+    EXPECT_FALSE(loop.is_valid(refused));
+    EXPECT_TRUE(loop.is_valid(silent));
+
+    loop.remove_endpoint(silent);
+}
+
+TEST(EventLoopTest, test_expired_request_is_not_sent) {
+
+    using namespace everest::modbus;
+    using everest::connection::EventLoop;
+
+    // a request large enough to fill the socket buffers keeps the next one in the send queue
+    DataVectorUint8 large_request(16 * 1024 * 1024);
+    large_request[1] = 1;
+    DataVectorUint8 queued_request{0x00, 0x02, 0x00, 0x00, 0x00, 0x06, 0x01, 0x03, 0x00, 0x01, 0x00, 0x01};
+
+    std::promise<void> queued_expired;
+    std::promise<std::size_t> extra_bytes;
+    LoopbackServer server;
+    server.serve([&](int fd) {
+        queued_expired.get_future().wait();
+        LoopbackServer::receive_exactly(fd, large_request.size());
+        timeval timeout{0, 200 * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        uint8_t buffer[64];
+        ssize_t bytes = recv(fd, buffer, sizeof(buffer), 0);
+        extra_bytes.set_value(bytes > 0 ? bytes : 0);
+    });
+
+    EventLoop loop;
+    EventLoop::EndpointId endpoint = loop.add_endpoint("127.0.0.1", server.port());
+    std::exception_ptr queued_error;
+    loop.submit(endpoint, large_request, [](DataVectorUint8, std::exception_ptr) {}, std::chrono::milliseconds(1000));
+    loop.submit(
+        endpoint, queued_request, [&](DataVectorUint8, std::exception_ptr error) { queued_error = error; },
+        std::chrono::milliseconds(50));
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (not queued_error and std::chrono::steady_clock::now() < deadline)
+        loop.run_once(std::chrono::milliseconds(100));
+    ASSERT_TRUE(queued_error);
+    EXPECT_THROW(std::rethrow_exception(queued_error), everest::connection::exceptions::timeout_error);
+    queued_expired.set_value();
+
+    // the partially sent request is completed, the expired one behind it is not sent
+    std::future<std::size_t> received_extra = extra_bytes.get_future();
+    while (received_extra.wait_for(std::chrono::seconds(0)) != std::future_status::ready and
+           std::chrono::steady_clock::now() < deadline)
+        loop.run_once(std::chrono::milliseconds(10));
+    EXPECT_EQ(received_extra.get(), 0);
+
+    loop.remove_endpoint(endpoint);
+}
+
+TEST(AsyncClientTest, test_callbacks) {
+
+    using namespace everest::modbus;
+    using everest::connection::EventLoop;
+
+    LoopbackServer server;
+    server.serve([](int fd) {
+        LoopbackServer::DataVector reply =
+            LoopbackServer::make_read_reply(LoopbackServer::receive_exactly(fd, read_request_size));
+        send(fd, reply.data(), reply.size(), 0);
+
+        // exception response to the write request: unit id, function code, exception code
+        LoopbackServer::DataVector request = LoopbackServer::receive_exactly(fd, read_request_size + 1 + 2);
+        LoopbackServer::DataVector exception_reply(request.begin(), request.begin() + 8);
+        exception_reply[5] = 3;
+        exception_reply[7] |= 0x80;
+        exception_reply.push_back(0x04);
+        send(fd, exception_reply.data(), exception_reply.size(), 0);
+    });
+
+    EventLoop loop;
+    ModbusAsyncIPClient client(loop, loop.add_endpoint("127.0.0.1", server.port()));
+
+    DataVectorUint8 registers;
+    std::exception_ptr write_error;
+    bool done = false;
+    client.async_read_input_register(1, 0x0102, 1, [&](DataVectorUint8 result, std::exception_ptr error) {
+        ASSERT_FALSE(error);
+        registers = std::move(result);
+        // follow up requests can be sent from the callback
+        client.async_write_multiple_registers(1, 0x0001, 1, ModbusDataContainerUint16(ByteOrder::LittleEndian, {1}),
+                                              [&](DataVectorUint8, std::exception_ptr error) {
+                                                  write_error = error;
+                                                  done = true;
+                                              });
+    });
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (not done and std::chrono::steady_clock::now() < deadline)
+        loop.run_once(std::chrono::milliseconds(100));
+
+    ASSERT_TRUE(done);
+    EXPECT_EQ(registers, (DataVectorUint8{0x01, 0x02}));
+    ASSERT_TRUE(write_error);
+    EXPECT_THROW(std::rethrow_exception(write_error), exceptions::modbus_exception);
+}
+
+#ifdef MODBUS_HAVE_COROUTINES
+
+// fire and forget coroutine, just enough to drive the awaitables of the client
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {
+        }
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
+
+static DetachedTask poll_device(everest::modbus::ModbusAsyncIPClient& client, std::vector<uint8_t>& result,
+                                bool& timed_out) {
+
+    using namespace everest::modbus;
+
+    DataVectorUint8 first = co_await async_read_holding_register(client, 1, 0x0010, 1);
+    DataVectorUint8 second = co_await async_read_holding_register(client, 1, 0x0020, 2);
+    result = first;
+    result.insert(result.end(), second.begin(), second.end());
+
+    client.set_transaction_timeout(std::chrono::milliseconds(50));
+    try {
+        co_await async_read_holding_register(client, 1, 0x0030, 1);
+    } catch (const everest::connection::exceptions::timeout_error&) {
+        timed_out = true;
+    }
+}
+
+TEST(AsyncClientTest, test_coroutines) {
+
+    using namespace everest::modbus;
+    using everest::connection::EventLoop;
+
+    LoopbackServer server;
+    server.serve([](int fd) {
+        for (int index = 0; index < 2; ++index) {
+            LoopbackServer::DataVector reply =
+                LoopbackServer::make_read_reply(LoopbackServer::receive_exactly(fd, read_request_size));
+            send(fd, reply.data(), reply.size(), 0);
+        }
+        // the third request stays unanswered until the client hangs up
+        LoopbackServer::receive_exactly(fd, read_request_size + 1);
+    });
+
+    EventLoop loop;
+    ModbusAsyncIPClient client(loop, loop.add_endpoint("127.0.0.1", server.port()));
+
+    DataVectorUint8 result;
+    bool timed_out = false;
+    poll_device(client, result, timed_out);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (not timed_out and std::chrono::steady_clock::now() < deadline)
+        loop.run_once(std::chrono::milliseconds(100));
+
+    EXPECT_EQ(result, (DataVectorUint8{0x00, 0x10, 0x00, 0x20, 0x00, 0x21}));
+    EXPECT_TRUE(timed_out);
+}
+
+#endif